@@ -16,8 +16,30 @@
 // number of edges or links from the root node to a node).
 
 #include <iostream>
+#include <sstream>
+#include <memory>
 #include <stack>
 #include <map>
+#include <vector>
+#include <unordered_map>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <limits>
+#include <set>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include <algorithm>
 
 struct Node {
     int data;
@@ -237,31 +259,3723 @@ int sumPostorder(NodePtr node) {
     return node->data + prevData; 
 };
 
-// - Determine whether the given binary tree nodes are cousins of each other
+// Helpers used by the benchmarks below.
+// makeRandomTree builds a tree of n nodes (data = 1..n) by hanging each new 
+// node from a random free child slot, which keeps the height around O(log n).
+NodePtr makeRandomTree(int n, unsigned seed = 42) {
+    if (n <= 0) return nullptr;
+    std::mt19937 rng(seed);
+    std::vector<NodePtr> open;
+    auto root = std::make_shared<Node>(1);
+    open.push_back(root);
+    for (int i = 2; i <= n; i++)
+    {
+        size_t pick = rng() % open.size();
+        NodePtr parent = open[pick];
+        auto child = std::make_shared<Node>(i);
+        if (!parent->left && (parent->right || rng() % 2 == 0)) {
+            parent->left = child;
+        } else {
+            parent->right = child;
+        }
+        if (parent->left && parent->right) {
+            open[pick] = open.back();
+            open.pop_back();
+        }
+        open.push_back(child);
+    }
+    return root;
+}
+
+template <typename F>
+double timeMs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Flat index of a tree: every node gets an id in preorder, and parent/depth 
+// are kept in arrays keyed by that id. Building it is one iterative pass, 
+// after which the query structures below never touch the shared_ptrs again.
+struct TreeIndex {
+    std::vector<NodePtr> nodes; // id -> node
+    std::vector<int> parent;    // id -> parent id, -1 for the root
+    std::vector<int> left;      // id -> left child id, -1 if none
+    std::vector<int> right;     // id -> right child id, -1 if none
+    std::vector<int> depth;     // id -> number of edges from the root
+    std::unordered_map<const Node*, int> ids;
+
+    int size() const { return (int)nodes.size(); }
+
+    int idOf(const NodePtr& node) const {
+        auto it = ids.find(node.get());
+        return it == ids.end() ? -1 : it->second;
+    }
+};
+
+TreeIndex buildIndex(NodePtr root) {
+    TreeIndex index;
+    if (!root) return index;
+
+    struct Entry { Node* node; int parent; bool isLeft; };
+    // right pushed first so ids come out in preorder
+    std::vector<Entry> stack;
+    stack.push_back({root.get(), -1, false});
+
+    while (!stack.empty())
+    {
+        Entry e = stack.back();
+        stack.pop_back();
+
+        int id = index.size();
+        NodePtr self = e.parent < 0 ? root 
+            : (e.isLeft ? index.nodes[e.parent]->left : index.nodes[e.parent]->right);
+        index.nodes.push_back(self);
+        index.parent.push_back(e.parent);
+        index.left.push_back(-1);
+        index.right.push_back(-1);
+        index.depth.push_back(e.parent < 0 ? 0 : index.depth[e.parent] + 1);
+        index.ids[e.node] = id;
+        if (e.parent >= 0) {
+            (e.isLeft ? index.left : index.right)[e.parent] = id;
+        }
+
+        if (e.node->right) stack.push_back({e.node->right.get(), id, false});
+        if (e.node->left) stack.push_back({e.node->left.get(), id, true});
+    }
+    return index;
+}
+
+// Lowest Common Ancestor (LCA) of two nodes x and y is the deepest node that
+// has both x and y as descendants (a node is a descendant of itself).
+//
+// The naive approach searches the whole tree for every query: a node is the LCA 
+// if x and y are found in different subtrees, or if it is x or y itself.
+NodePtr lcaNaive(NodePtr node, const Node* x, const Node* y) {
+    if (!node) return nullptr;
+    if (node.get() == x || node.get() == y) return node;
+
+    NodePtr left = lcaNaive(node->left, x, y);
+    NodePtr right = lcaNaive(node->right, x, y);
+
+    if (left && right) return node;
+    return left ? left : right;
+}
+
+// For many queries over the same tree we walk it once and record an Euler 
+// tour (every node is written each time the walk enters or returns to it). 
+// The LCA of x and y is then the shallowest node on the tour between the 
+// first visits of x and y, which a sparse table answers in O(1):
+// table[k][i] holds the shallowest node in tour[i, i + 2^k).
+// Build is O(n log n) time and memory, queries are O(1).
+class LcaIndex {
+public:
+    explicit LcaIndex(NodePtr root) : index(buildIndex(root))
+    {
+        int n = index.size();
+        if (n == 0) return;
+
+        std::vector<int> tour;
+        tour.reserve(2 * n - 1);
+        first.assign(n, -1);
+
+        // state[id]: 0 = nothing visited yet, 1 = left done, 2 = both done
+        std::vector<char> state(n, 0);
+        std::vector<int> stack;
+        stack.push_back(0);
+        first[0] = 0;
+        tour.push_back(0);
+
+        while (!stack.empty())
+        {
+            int id = stack.back();
+            int child = -1;
+            if (state[id] == 0) {
+                state[id] = 1;
+                child = index.left[id];
+            }
+            if (child < 0 && state[id] == 1) {
+                state[id] = 2;
+                child = index.right[id];
+            }
+
+            if (child >= 0) {
+                first[child] = (int)tour.size();
+                tour.push_back(child);
+                stack.push_back(child);
+            } else {
+                stack.pop_back();
+                if (!stack.empty()) tour.push_back(stack.back());
+            }
+        }
+
+        int m = (int)tour.size();
+        log2.assign(m + 1, 0);
+        for (int i = 2; i <= m; i++) log2[i] = log2[i / 2] + 1;
+
+        table.assign(log2[m] + 1, std::vector<int>(m));
+        table[0] = tour;
+        for (int k = 1; k < (int)table.size(); k++)
+        {
+            int half = 1 << (k - 1);
+            for (int i = 0; i + (1 << k) <= m; i++)
+            {
+                table[k][i] = shallower(table[k - 1][i], table[k - 1][i + half]);
+            }
+        }
+    }
+
+    const TreeIndex& tree() const { return index; }
+
+    // LCA by node id; both ids must be valid
+    int lca(int x, int y) const {
+        int l = first[x], r = first[y];
+        if (l > r) std::swap(l, r);
+        int k = log2[r - l + 1];
+        return shallower(table[k][l], table[k][r - (1 << k) + 1]);
+    }
+
+    NodePtr lca(const NodePtr& x, const NodePtr& y) const {
+        int a = index.idOf(x), b = index.idOf(y);
+        if (a < 0 || b < 0) return nullptr;
+        return index.nodes[lca(a, b)];
+    }
+
+    // Answers queries[i] into out[i] (ids in, ids out).
+    void lcaBatch(const std::vector<std::pair<int, int>>& queries, std::vector<int>& out) const {
+        out.resize(queries.size());
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            out[i] = lca(queries[i].first, queries[i].second);
+        }
+    }
+
+private:
+    TreeIndex index;
+    std::vector<int> first;               // id -> first position in the tour
+    std::vector<int> log2;
+    std::vector<std::vector<int>> table;
+
+    int shallower(int a, int b) const {
+        return index.depth[a] <= index.depth[b] ? a : b;
+    }
+};
+
+// Binary lifting keeps up[k][id] = the 2^k-th ancestor of id. It needs about 
+// half the memory of the Euler tour table (n log n instead of 2n log 2n) at the
+// cost of O(log n) per query: lift the deeper node to the same depth, then lift
+// both while their ancestors differ.
+class LcaLifting {
+public:
+    explicit LcaLifting(NodePtr root) : index(buildIndex(root))
+    {
+        int n = index.size();
+        int levels = 1;
+        while ((1 << levels) < n) levels++;
+
+        up.assign(levels, std::vector<int>(n));
+        for (int id = 0; id < n; id++)
+        {
+            up[0][id] = index.parent[id] < 0 ? id : index.parent[id];
+        }
+        for (int k = 1; k < levels; k++)
+        {
+            for (int id = 0; id < n; id++)
+            {
+                up[k][id] = up[k - 1][up[k - 1][id]];
+            }
+        }
+    }
+
+    const TreeIndex& tree() const { return index; }
+
+    int lca(int x, int y) const {
+        if (index.depth[x] < index.depth[y]) std::swap(x, y);
+
+        int diff = index.depth[x] - index.depth[y];
+        for (int k = 0; diff; k++, diff >>= 1)
+        {
+            if (diff & 1) x = up[k][x];
+        }
+        if (x == y) return x;
+
+        for (int k = (int)up.size() - 1; k >= 0; k--)
+        {
+            if (up[k][x] != up[k][y]) {
+                x = up[k][x];
+                y = up[k][y];
+            }
+        }
+        return up[0][x];
+    }
+
+    void lcaBatch(const std::vector<std::pair<int, int>>& queries, std::vector<int>& out) const {
+        out.resize(queries.size());
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            out[i] = lca(queries[i].first, queries[i].second);
+        }
+    }
+
+private:
+    TreeIndex index;
+    std::vector<std::vector<int>> up;
+};
+
+void benchmarkLca(int n, int queries) {
+    NodePtr root = makeRandomTree(n);
+    std::mt19937 rng(7);
+
+    LcaIndex euler(nullptr);
+    LcaLifting lifting(nullptr);
+    double buildEuler = timeMs([&] { euler = LcaIndex(root); });
+    double buildLifting = timeMs([&] { lifting = LcaLifting(root); });
+
+    std::vector<std::pair<int, int>> batch(queries);
+    for (auto& q : batch) q = { (int)(rng() % n), (int)(rng() % n) };
+
+    std::vector<int> outEuler, outLifting;
+    double queryEuler = timeMs([&] { euler.lcaBatch(batch, outEuler); });
+    double queryLifting = timeMs([&] { lifting.lcaBatch(batch, outLifting); });
+
+    // the naive version is O(n) per query, so only time a sample of them
+    int sample = std::min(queries, 100);
+    const TreeIndex& index = euler.tree();
+    int mismatches = 0;
+    double queryNaive = timeMs([&] {
+        for (int i = 0; i < sample; i++)
+        {
+            NodePtr l = lcaNaive(root, index.nodes[batch[i].first].get(), 
+                                 index.nodes[batch[i].second].get());
+            if (l != index.nodes[outEuler[i]]) mismatches++;
+        }
+    });
+    for (int i = 0; i < queries; i++)
+    {
+        if (outEuler[i] != outLifting[i]) mismatches++;
+    }
+
+    std::cout << "LCA n=" << n << " queries=" << queries << "\n"
+              << "  euler tour: build " << buildEuler << " ms, queries " << queryEuler << " ms\n"
+              << "  lifting:    build " << buildLifting << " ms, queries " << queryLifting << " ms\n"
+              << "  naive:      " << queryNaive / sample * queries << " ms (extrapolated from " 
+              << sample << ")\n"
+              << "  mismatches: " << mismatches << "\n";
+}
+
+// The distance between two nodes is the number of edges on the path joining
+// them. That path always goes through their LCA, so with depths and the LCA 
+// index precomputed each query is O(1):
+//      dist(x, y) = depth(x) + depth(y) - 2 * depth(lca(x, y))
+int distance(const LcaIndex& lca, int x, int y) {
+    const std::vector<int>& depth = lca.tree().depth;
+    return depth[x] + depth[y] - 2 * depth[lca.lca(x, y)];
+}
+
+// Returns -1 if either node is not part of the indexed tree.
+int distance(const LcaIndex& lca, const NodePtr& x, const NodePtr& y) {
+    int a = lca.tree().idOf(x), b = lca.tree().idOf(y);
+    if (a < 0 || b < 0) return -1;
+    return distance(lca, a, b);
+}
+
+// Answers queries[i] into out[i]. Queries are first grouped by the smaller of 
+// their two ids with a counting sort, so consecutive lookups hit neighbouring
+// entries of the depth array and sparse table instead of jumping around. 
+// With threads > 1 the sorted batch is split into contiguous chunks, each 
+// answered by its own thread; results land in their original positions.
+void distanceBatch(const LcaIndex& lca, const std::vector<std::pair<int, int>>& queries, 
+                   std::vector<int>& out, int threads = 1) {
+    size_t q = queries.size();
+    out.resize(q);
+    if (q == 0) return;
+
+    int n = lca.tree().size();
+    std::vector<int> bucketStart(n + 1, 0);
+    for (auto& [x, y] : queries) bucketStart[std::min(x, y) + 1]++;
+    for (int i = 0; i < n; i++) bucketStart[i + 1] += bucketStart[i];
+
+    std::vector<int> order(q);
+    for (size_t i = 0; i < q; i++)
+    {
+        order[bucketStart[std::min(queries[i].first, queries[i].second)]++] = (int)i;
+    }
+
+    auto work = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            int k = order[i];
+            out[k] = distance(lca, queries[k].first, queries[k].second);
+        }
+    };
+
+    if (threads <= 1) {
+        work(0, q);
+        return;
+    }
+
+    std::vector<std::thread> pool;
+    size_t chunk = (q + threads - 1) / threads;
+    for (size_t begin = 0; begin < q; begin += chunk)
+    {
+        pool.emplace_back(work, begin, std::min(q, begin + chunk));
+    }
+    for (auto& t : pool) t.join();
+}
+
+// The diameter of a binary tree is the number of edges on the longest path 
+// between any two nodes. The longest path either goes through the root (the
+// left height plus the right height) or lies entirely inside one subtree.
+//
+// The naive version below recomputes heights for every node, which is O(n^2)
+// on a skewed tree and O(n log n) on a balanced one.
+int height(NodePtr node) {
+    if (!node) return -1;
+    return std::max(height(node->left), height(node->right)) + 1;
+}
+
+int diameterNaive(NodePtr node) {
+    if (!node) return 0;
+    int through = height(node->left) + height(node->right) + 2;
+    return std::max({through, diameterNaive(node->left), diameterNaive(node->right)});
+}
+
+struct Diameter {
+    int length = 0;     // in edges
+    NodePtr from;
+    NodePtr to;
+};
+
+// Per-subtree summary used by the linear version. Pointers refer to the 
+// shared_ptr that owns a node (root or a parent's child field), so combining
+// results never touches reference counts.
+struct DiameterInfo {
+    int height = -1;                // -1 for an empty subtree
+    const NodePtr* deepest = nullptr;
+    int best = 0;
+    const NodePtr* from = nullptr;
+    const NodePtr* to = nullptr;
+};
+
+DiameterInfo combineDiameter(const NodePtr* node, const DiameterInfo& l, const DiameterInfo& r) {
+    DiameterInfo info;
+    info.height = std::max(l.height, r.height) + 1;
+    info.deepest = l.height >= r.height && l.deepest ? l.deepest 
+                 : r.deepest ? r.deepest : node;
+
+    int through = l.height + r.height + 2;
+    info.best = through;
+    info.from = l.deepest ? l.deepest : node;
+    info.to = r.deepest ? r.deepest : node;
+    if (l.best > info.best) {
+        info.best = l.best;
+        info.from = l.from;
+        info.to = l.to;
+    }
+    if (r.best > info.best) {
+        info.best = r.best;
+        info.from = r.from;
+        info.to = r.to;
+    }
+    return info;
+}
+
+// Single iterative postorder pass: each node is pushed once to expand its 
+// children and once more to combine their results, which are kept on a 
+// separate stack. Memory is O(height) and there is no recursion.
+DiameterInfo diameterInfo(const NodePtr* root) {
+    if (!*root) return {};
+
+    std::vector<std::pair<const NodePtr*, bool>> stack;
+    std::vector<DiameterInfo> results;
+    stack.push_back({root, false});
+
+    while (!stack.empty())
+    {
+        auto [node, expanded] = stack.back();
+        stack.pop_back();
+
+        if (!*node) {
+            results.push_back({});
+        } else if (!expanded) {
+            stack.push_back({node, true});
+            stack.push_back({&(*node)->right, false});
+            stack.push_back({&(*node)->left, false});
+        } else {
+            DiameterInfo r = results.back();
+            results.pop_back();
+            DiameterInfo l = results.back();
+            results.pop_back();
+            results.push_back(combineDiameter(node, l, r));
+        }
+    }
+    return results.back();
+}
+
+Diameter toDiameter(const DiameterInfo& info) {
+    Diameter d;
+    d.length = info.best;
+    if (info.from) d.from = *info.from;
+    if (info.to) d.to = *info.to;
+    return d;
+}
+
+Diameter diameter(const NodePtr& root) {
+    return toDiameter(diameterInfo(&root));
+}
+
+// Parallel variant: the top `levels` levels are split recursively, giving up
+// to 2^levels subtrees that are solved concurrently; their (height, diameter)
+// summaries are then merged back up with the same combine step.
+DiameterInfo diameterTop(const NodePtr* node, int levels) {
+    if (!*node) return {};
+    if (levels == 0) return diameterInfo(node);
+
+    auto left = std::async(std::launch::async, diameterTop, &(*node)->left, levels - 1);
+    DiameterInfo right = diameterTop(&(*node)->right, levels - 1);
+    return combineDiameter(node, left.get(), right);
+}
+
+Diameter diameterParallel(const NodePtr& root, int levels = 3) {
+    return toDiameter(diameterTop(&root, levels));
+}
+
+void benchmarkDiameter(int n) {
+    NodePtr root = makeRandomTree(n);
+
+    int naive = 0;
+    Diameter linear, parallel;
+    double tNaive = timeMs([&] { naive = diameterNaive(root); });
+    double tLinear = timeMs([&] { linear = diameter(root); });
+    double tParallel = timeMs([&] { parallel = diameterParallel(root); });
+
+    std::cout << "Diameter n=" << n << "\n"
+              << "  naive:    " << naive << " in " << tNaive << " ms\n"
+              << "  linear:   " << linear.length << " in " << tLinear << " ms ("
+              << linear.from->data << " - " << linear.to->data << ")\n"
+              << "  parallel: " << parallel.length << " in " << tParallel << " ms\n";
+}
+
+// A binary tree is symmetric if its left subtree is a mirror image of its 
+// right subtree. Both halves are walked at the same time, pairing the left 
+// child of one side with the right child of the other, and the walk stops at
+// the first pair that differs.
+bool isSymmetric(NodePtr root) {
+    if (!root) return true;
+
+    std::vector<std::pair<const Node*, const Node*>> stack;
+    stack.push_back({root->left.get(), root->right.get()});
+
+    while (!stack.empty())
+    {
+        auto [x, y] = stack.back();
+        stack.pop_back();
+
+        if (!x && !y) continue;
+        if (!x || !y || x->data != y->data) return false;
+
+        stack.push_back({x->left.get(), y->right.get()});
+        stack.push_back({x->right.get(), y->left.get()});
+    }
+    return true;
+}
+
+// Converting a tree to its mirror (inverting it) swaps the left and right 
+// children of every node. shared_ptr::swap exchanges the two control block 
+// pointers directly, so no reference count is touched and nothing is 
+// allocated apart from the O(height) stack of raw pointers.
+void mirror(NodePtr root) {
+    if (!root) return;
+
+    std::vector<Node*> stack;
+    stack.push_back(root.get());
+
+    while (!stack.empty())
+    {
+        Node* curr = stack.back();
+        stack.pop_back();
+
+        curr->left.swap(curr->right);
+
+        if (curr->left) stack.push_back(curr->left.get());
+        if (curr->right) stack.push_back(curr->right.get());
+    }
+}
+
+void invert(NodePtr root) {
+    mirror(root);
+}
+
+// Builds a mirrored copy and leaves the original untouched, for when the 
+// tree is shared with code that must keep seeing the original orientation.
+NodePtr mirrorCopy(NodePtr root) {
+    if (!root) return nullptr;
+
+    NodePtr copy = std::make_shared<Node>(root->data);
+    std::vector<std::pair<const Node*, Node*>> stack;
+    stack.push_back({root.get(), copy.get()});
+
+    while (!stack.empty())
+    {
+        auto [from, to] = stack.back();
+        stack.pop_back();
+
+        if (from->right) {
+            to->left = std::make_shared<Node>(from->right->data);
+            stack.push_back({from->right.get(), to->left.get()});
+        }
+        if (from->left) {
+            to->right = std::make_shared<Node>(from->left->data);
+            stack.push_back({from->left.get(), to->right.get()});
+        }
+    }
+    return copy;
+}
+
+// Lazy mirror: instead of rewriting the tree, a view carries a flag that 
+// swaps which child is read as "left". Flipping it is O(1) and traversals 
+// written against the view pay one branch per child access.
+struct TreeView {
+    NodePtr root;
+    bool mirrored = false;
+
+    const NodePtr& left(const Node* node) const { return mirrored ? node->right : node->left; }
+    const NodePtr& right(const Node* node) const { return mirrored ? node->left : node->right; }
+
+    TreeView mirror() const { return { root, !mirrored }; }
+};
+
+void inorderIterative(const TreeView& view) {
+    std::vector<const Node*> stack;
+    const Node* curr = view.root.get();
+
+    while (!stack.empty() || curr)
+    {
+        if (curr) {
+            stack.push_back(curr);
+            curr = view.left(curr).get();
+        } else {
+            curr = stack.back();
+            stack.pop_back();
+
+            std::cout << curr->data << " ";
+
+            curr = view.right(curr).get();
+        }
+    }
+}
+
+void preorderIterative(const TreeView& view) {
+    if (!view.root) return;
+    std::vector<const Node*> stack;
+    stack.push_back(view.root.get());
+
+    while (!stack.empty())
+    {
+        const Node* curr = stack.back();
+        stack.pop_back();
+
+        std::cout << curr->data << " ";
+
+        if (view.right(curr)) stack.push_back(view.right(curr).get());
+        if (view.left(curr)) stack.push_back(view.left(curr).get());
+    }
+}
+
+// Two nodes are cousins if they are on the same level but have different 
+// parents. Node has no parent link, so the index records parent and depth per
+// node id once (see TreeIndex) and also groups ids by level with a counting 
+// sort: level d occupies byLevel[levelStart[d], levelStart[d + 1]).
+// areCousins is then O(1) and listing the cousins of a node only scans its 
+// own level.
+class CousinIndex {
+public:
+    explicit CousinIndex(NodePtr root) : index(buildIndex(root))
+    {
+        int n = index.size();
+        int levels = 0;
+        for (int d : index.depth) levels = std::max(levels, d + 1);
+
+        levelStart.assign(levels + 1, 0);
+        for (int d : index.depth) levelStart[d + 1]++;
+        for (int d = 0; d < levels; d++) levelStart[d + 1] += levelStart[d];
+
+        byLevel.resize(n);
+        std::vector<int> next(levelStart.begin(), levelStart.end() - 1);
+        for (int id = 0; id < n; id++) byLevel[next[index.depth[id]]++] = id;
+    }
+
+    const TreeIndex& tree() const { return index; }
+
+    bool areCousins(int x, int y) const {
+        return index.depth[x] == index.depth[y] && index.parent[x] != index.parent[y];
+    }
+
+    bool areCousins(const NodePtr& x, const NodePtr& y) const {
+        int a = index.idOf(x), b = index.idOf(y);
+        return a >= 0 && b >= 0 && areCousins(a, b);
+    }
+
+    // Cousins of x from left to right (ids are preorder, so within a level 
+    // they are already ordered left to right).
+    std::vector<NodePtr> cousins(const NodePtr& x) const {
+        std::vector<NodePtr> out;
+        int id = index.idOf(x);
+        if (id < 0) return out;
+
+        int d = index.depth[id];
+        for (int i = levelStart[d]; i < levelStart[d + 1]; i++)
+        {
+            if (index.parent[byLevel[i]] != index.parent[id]) {
+                out.push_back(index.nodes[byLevel[i]]);
+            }
+        }
+        return out;
+    }
+
+    void printCousins(const NodePtr& x) const {
+        for (auto& node : cousins(x)) {
+            std::cout << node->data << " ";
+        }
+    }
+
+private:
+    TreeIndex index;
+    std::vector<int> levelStart;  // level -> first position in byLevel
+    std::vector<int> byLevel;     // ids grouped by level
+};
+
+// A sum tree is a binary tree where the value of each non-leaf node equals 
+// the sum of all the values in its left and right subtrees. Leaves and the 
+// empty tree are sum trees.
+//
+// Unlike sumPostorder this leaves Node::data alone: subtree totals are kept 
+// on a side stack during a single iterative postorder pass, and the pass stops
+// at the first node (in postorder) whose value does not match.
+//
+// Totals are accumulated in 64 bits. In SumOverflow::Detect mode the pass 
+// also reports when the value a node is compared against - the sum of its 
+// children's subtree totals - does not fit in an int (the type of 
+// Node::data). Such a node can never match, so it is still the violation, 
+// but overflow tells the caller that an int accumulator (as in sumPostorder)
+// would have wrapped there. A valid sum tree never sets it.
+enum class SumOverflow { Widen, Detect };
+
+struct SumTreeResult {
+    NodePtr violation;        // null when the tree is a sum tree
+    bool overflow = false;    // the violation's expected value does not fit in an int
+    long long total = 0;      // sum of every value in the tree, when checked fully
+
+    bool isSumTree() const { return !violation; }
+};
+
+struct SumTreeState {
+    long long total = 0;
+    const NodePtr* violation = nullptr;
+    bool overflow = false;
+};
+
+// Compares one internal node with the subtree totals of its children.
+bool matchesChildren(const Node* node, long long left, long long right, SumOverflow mode, bool& overflow) {
+    long long expected = left + right;
+    if (mode == SumOverflow::Detect 
+        && (expected > std::numeric_limits<int>::max() || expected < std::numeric_limits<int>::min())) {
+        overflow = true;
+    }
+    return node->data == expected;
+}
+
+SumTreeState checkSumTree(const NodePtr* root, SumOverflow mode, 
+                          const std::atomic<bool>* stop = nullptr) {
+    SumTreeState state;
+    if (!*root) return state;
+
+    std::vector<std::pair<const NodePtr*, bool>> stack;
+    std::vector<long long> totals;
+    stack.push_back({root, false});
+
+    while (!stack.empty())
+    {
+        if (stop && stop->load(std::memory_order_relaxed)) return state;
+
+        auto [node, expanded] = stack.back();
+        stack.pop_back();
+        const Node* curr = node->get();
+
+        if (!curr) {
+            totals.push_back(0);
+        } else if (!expanded) {
+            stack.push_back({node, true});
+            stack.push_back({&curr->right, false});
+            stack.push_back({&curr->left, false});
+        } else {
+            long long right = totals.back();
+            totals.pop_back();
+            long long left = totals.back();
+            totals.pop_back();
+
+            bool leaf = !curr->left && !curr->right;
+            long long total = curr->data + left + right;
+
+            if (!leaf && !matchesChildren(curr, left, right, mode, state.overflow)) {
+                state.violation = node;
+                return state;
+            }
+            totals.push_back(total);
+        }
+    }
+    state.total = totals.back();
+    return state;
+}
+
+SumTreeResult isSumTree(const NodePtr& root, SumOverflow mode = SumOverflow::Widen) {
+    SumTreeState state = checkSumTree(&root, mode);
+    SumTreeResult result;
+    if (state.violation) result.violation = *state.violation;
+    result.overflow = state.overflow;
+    result.total = state.total;
+    return result;
+}
+
+// Parallel variant: subtrees below the top `levels` levels are checked 
+// concurrently. A shared flag stops every worker once any of them finds a 
+// violation, so the node reported is *a* violating node, not necessarily 
+// the first one in postorder.
+SumTreeState sumTreeTop(const NodePtr* node, int levels, SumOverflow mode, std::atomic<bool>* stop) {
+    if (!*node) return {};
+    if (levels == 0) {
+        SumTreeState state = checkSumTree(node, mode, stop);
+        if (state.violation) stop->store(true);
+        return state;
+    }
+
+    auto leftTask = std::async(std::launch::async, sumTreeTop, &(*node)->left, levels - 1, mode, stop);
+    SumTreeState right = sumTreeTop(&(*node)->right, levels - 1, mode, stop);
+    SumTreeState left = leftTask.get();
+
+    if (left.violation) return left;
+    if (right.violation) return right;
+
+    SumTreeState state;
+    if (stop->load()) return state;
+
+    const Node* curr = node->get();
+    bool leaf = !curr->left && !curr->right;
+    state.total = curr->data + left.total + right.total;
+    if (!leaf && !matchesChildren(curr, left.total, right.total, mode, state.overflow)) {
+        state.violation = node;
+    }
+    if (state.violation) stop->store(true);
+    return state;
+}
+
+SumTreeResult isSumTreeParallel(const NodePtr& root, SumOverflow mode = SumOverflow::Widen, int levels = 3) {
+    std::atomic<bool> stop{false};
+    SumTreeState state = sumTreeTop(&root, levels, mode, &stop);
+    SumTreeResult result;
+    if (state.violation) result.violation = *state.violation;
+    result.overflow = state.overflow;
+    result.total = state.total;
+    return result;
+}
+
+// Root-to-leaf paths. Copying a vector for every path costs O(n * height) 
+// memory on top of the allocations; instead the generator keeps one path 
+// buffer that grows and shrinks with the DFS, and each path is exposed as a 
+// view into that buffer. A view stays valid until the generator advances.
+struct PathSpan {
+    const int* first = nullptr;
+    size_t count = 0;
+
+    const int* begin() const { return first; }
+    const int* end() const { return first + count; }
+    size_t size() const { return count; }
+    int operator[](size_t i) const { return first[i]; }
+};
+
+class PathGenerator {
+public:
+    explicit PathGenerator(NodePtr root) : root(root) {}
+
+    // Moves to the next root-to-leaf path, left to right. Returns false once
+    // every path has been produced.
+    bool next() {
+        if (!started) {
+            started = true;
+            if (!root) return false;
+            push(root.get());
+            if (isLeaf(root.get())) return true;
+        }
+
+        while (!frames.empty())
+        {
+            Frame& top = frames.back();
+            const Node* child = nullptr;
+            if (top.state == 0) {
+                top.state = 1;
+                child = top.node->left.get();
+            }
+            if (!child && top.state == 1) {
+                top.state = 2;
+                child = top.node->right.get();
+            }
+
+            if (child) {
+                push(child);
+                if (isLeaf(child)) return true;
+            } else {
+                frames.pop_back();
+                values.pop_back();
+            }
+        }
+        return false;
+    }
+
+    PathSpan path() const { return { values.data(), values.size() }; }
+
+private:
+    struct Frame {
+        const Node* node;
+        char state;         // 0 = fresh, 1 = left taken, 2 = both taken
+    };
+
+    NodePtr root;
+    bool started = false;
+    std::vector<Frame> frames;
+    std::vector<int> values;
+
+    static bool isLeaf(const Node* node) { return !node->left && !node->right; }
+
+    void push(const Node* node) {
+        frames.push_back({node, 0});
+        values.push_back(node->data);
+    }
+};
+
+// Range wrapper so paths can be consumed with a range-based for loop:
+//      for (PathSpan path : RootToLeafPaths(root)) { ... }
+class RootToLeafPaths {
+public:
+    explicit RootToLeafPaths(NodePtr root) : generator(root) {}
+
+    class iterator {
+    public:
+        explicit iterator(PathGenerator* gen) : gen(gen) { advance(); }
+
+        PathSpan operator*() const { return gen->path(); }
+        iterator& operator++() { advance(); return *this; }
+        bool operator!=(const iterator& other) const { return gen != other.gen; }
+
+    private:
+        PathGenerator* gen;
+
+        void advance() {
+            if (gen && !gen->next()) gen = nullptr;
+        }
+    };
+
+    iterator begin() { return iterator(&generator); }
+    iterator end() { return iterator(nullptr); }
+
+private:
+    PathGenerator generator;
+};
+
+void printPaths(NodePtr root) {
+    for (PathSpan path : RootToLeafPaths(root)) {
+        for (int value : path) {
+            std::cout << value << " ";
+        }
+        std::cout << "\n";
+    }
+}
+
+void benchmarkPaths(int n) {
+    NodePtr root = makeRandomTree(n);
+
+    long long paths = 0, totalLength = 0;
+    size_t longest = 0;
+    double ms = timeMs([&] {
+        for (PathSpan path : RootToLeafPaths(root)) {
+            paths++;
+            totalLength += path.size();
+            longest = std::max(longest, path.size());
+        }
+    });
+
+    std::cout << "Paths n=" << n << ": " << paths << " paths, " << totalLength 
+              << " values, longest " << longest << ", " << ms << " ms\n";
+}
+
+// Diagonals run parallel to the right edges of the tree: the root is on 
+// diagonal 0, a right child stays on its parent's diagonal and a left child
+// moves to the next one. Like the horizontal distance in printTop/printBottom,
+// but diagonals are always 0..height, so a flat array indexed by diagonal 
+// replaces the std::map.
+void addDiagonalSums(const Node* root, int base, std::vector<long long>& sums) {
+    if (!root) return;
+
+    std::vector<std::pair<const Node*, int>> stack;
+    stack.push_back({root, base});
+
+    while (!stack.empty())
+    {
+        auto [curr, d] = stack.back();
+        stack.pop_back();
+
+        if ((int)sums.size() <= d) sums.resize(d + 1, 0);
+        sums[d] += curr->data;
+
+        if (curr->right) stack.push_back({curr->right.get(), d});
+        if (curr->left) stack.push_back({curr->left.get(), d + 1});
+    }
+}
+
+std::vector<long long> diagonalSum(NodePtr root) {
+    std::vector<long long> sums;
+    addDiagonalSums(root.get(), 0, sums);
+    return sums;
+}
+
+// Parallel variant: nodes in the top `levels` levels are summed directly and 
+// every subtree hanging below them is summed by its own task into a private 
+// array, starting at the diagonal of its root. The arrays are then added into
+// the result.
+std::vector<long long> diagonalSumParallel(NodePtr root, int levels = 3) {
+    std::vector<long long> sums;
+    if (!root) return sums;
+
+    std::vector<std::pair<const Node*, int>> frontier;
+    std::vector<std::pair<const Node*, int>> next;
+    frontier.push_back({root.get(), 0});
+
+    for (int level = 0; level < levels && !frontier.empty(); level++)
+    {
+        next.clear();
+        for (auto [curr, d] : frontier)
+        {
+            if ((int)sums.size() <= d) sums.resize(d + 1, 0);
+            sums[d] += curr->data;
+            if (curr->left) next.push_back({curr->left.get(), d + 1});
+            if (curr->right) next.push_back({curr->right.get(), d});
+        }
+        frontier.swap(next);
+    }
+
+    std::vector<std::vector<long long>> partial(frontier.size());
+    std::vector<std::future<void>> tasks;
+    for (size_t i = 0; i < frontier.size(); i++)
+    {
+        tasks.push_back(std::async(std::launch::async, [&, i] {
+            addDiagonalSums(frontier[i].first, frontier[i].second, partial[i]);
+        }));
+    }
+    for (auto& t : tasks) t.get();
+
+    for (auto& part : partial)
+    {
+        if (sums.size() < part.size()) sums.resize(part.size(), 0);
+        for (size_t d = 0; d < part.size(); d++) sums[d] += part[d];
+    }
+    return sums;
+}
+
+// Diagonal traversal: the values of diagonal d, in preorder, are 
+// values[start[d], start[d + 1]). One preorder pass records each node's 
+// diagonal and a counting sort buckets them.
+struct DiagonalView {
+    std::vector<int> start;
+    std::vector<int> values;
+
+    int diagonals() const { return (int)start.size() - 1; }
+};
+
+DiagonalView diagonalView(NodePtr root) {
+    DiagonalView view;
+    std::vector<std::pair<int, int>> visited;  // (diagonal, value) in preorder
+
+    if (root) {
+        std::vector<std::pair<const Node*, int>> stack;
+        stack.push_back({root.get(), 0});
+        while (!stack.empty())
+        {
+            auto [curr, d] = stack.back();
+            stack.pop_back();
+
+            visited.push_back({d, curr->data});
+
+            if (curr->right) stack.push_back({curr->right.get(), d});
+            if (curr->left) stack.push_back({curr->left.get(), d + 1});
+        }
+    }
+
+    int diagonals = 0;
+    for (auto& [d, value] : visited) diagonals = std::max(diagonals, d + 1);
+
+    view.start.assign(diagonals + 1, 0);
+    for (auto& [d, value] : visited) view.start[d + 1]++;
+    for (int d = 0; d < diagonals; d++) view.start[d + 1] += view.start[d];
+
+    view.values.resize(visited.size());
+    std::vector<int> next(view.start.begin(), view.start.end() - 1);
+    for (auto& [d, value] : visited) view.values[next[d]++] = value;
+    return view;
+}
+
+void printDiagonal(NodePtr root) {
+    DiagonalView view = diagonalView(root);
+    for (int d = 0; d < view.diagonals(); d++)
+    {
+        for (int i = view.start[d]; i < view.start[d + 1]; i++)
+        {
+            std::cout << view.values[i] << " ";
+        }
+        std::cout << "\n";
+    }
+}
+
+// Dropping the last reference to a subtree makes shared_ptr destroy it 
+// recursively, one stack frame per level, which overflows on deep trees. 
+// releaseSubtrees takes detached subtrees and dismantles them from the top,
+// moving each node's children onto a work list before the node itself goes
+// away, so every destructor runs on a childless node. Subtrees that are 
+// still referenced elsewhere are left intact.
+void releaseSubtrees(std::vector<NodePtr>& garbage) {
+    while (!garbage.empty())
+    {
+        NodePtr node = std::move(garbage.back());
+        garbage.pop_back();
+
+        if (node.use_count() == 1) {
+            if (node->left) garbage.push_back(std::move(node->left));
+            if (node->right) garbage.push_back(std::move(node->right));
+        }
+    }
+}
+
+// Truncate a tree to remove the nodes that lie only on root-to-leaf paths 
+// whose sum is less than k. A node survives if the best root-to-leaf path 
+// through it reaches k, and that best sum never increases going down, so 
+// cutting a node always cuts its whole subtree.
+//
+// best(node) = (sum from the root down to node) + (max sum from node down to
+// a leaf) - node->data. It is computed once for every node; a batch of 
+// thresholds is then applied in increasing order, each step only cutting 
+// nodes whose best falls in [previous k, k).
+struct PathSumAnnotation {
+    std::vector<Node*> nodes;       // preorder
+    std::vector<int> parent;
+    std::vector<long long> best;
+};
+
+PathSumAnnotation annotatePathSums(const NodePtr& root) {
+    PathSumAnnotation a;
+    if (!root) return a;
+
+    std::vector<long long> prefix;
+    std::vector<std::pair<Node*, int>> stack;
+    stack.push_back({root.get(), -1});
+
+    while (!stack.empty())
+    {
+        auto [curr, parent] = stack.back();
+        stack.pop_back();
+
+        int id = (int)a.nodes.size();
+        a.nodes.push_back(curr);
+        a.parent.push_back(parent);
+        prefix.push_back((parent < 0 ? 0 : prefix[parent]) + curr->data);
+
+        if (curr->right) stack.push_back({curr->right.get(), id});
+        if (curr->left) stack.push_back({curr->left.get(), id});
+    }
+
+    // children come after their parent in preorder, so a reverse sweep sees
+    // every child's downward maximum before its parent's
+    int n = (int)a.nodes.size();
+    std::vector<long long> down(n, std::numeric_limits<long long>::min());
+    for (int id = n - 1; id >= 0; id--)
+    {
+        Node* curr = a.nodes[id];
+        if (!curr->left && !curr->right) down[id] = 0;
+        down[id] += curr->data;
+        int p = a.parent[id];
+        if (p >= 0) down[p] = std::max(down[p], down[id]);
+    }
+
+    a.best.resize(n);
+    for (int id = 0; id < n; id++)
+    {
+        a.best[id] = prefix[id] + down[id] - a.nodes[id]->data;
+    }
+    return a;
+}
+
+// Applies every threshold in ks (in increasing order) to the tree in place.
+// After each one, visit(k, root) sees the tree truncated for that k; root 
+// becomes null once no path reaches k. Removed subtrees are collected per 
+// step and released in bulk.
+template <typename Visit>
+void truncateBatch(NodePtr& root, std::vector<long long> ks, Visit visit) {
+    PathSumAnnotation a = annotatePathSums(root);
+    int n = (int)a.nodes.size();
+
+    std::vector<int> order(n);
+    for (int id = 0; id < n; id++) order[id] = id;
+    std::sort(order.begin(), order.end(), [&](int x, int y) { return a.best[x] < a.best[y]; });
+    std::sort(ks.begin(), ks.end());
+
+    std::vector<NodePtr> garbage;
+    int pos = 0;
+    for (long long k : ks)
+    {
+        for (; pos < n && a.best[order[pos]] < k; pos++)
+        {
+            int id = order[pos];
+            int p = a.parent[id];
+            if (p < 0) {
+                garbage.push_back(std::move(root));
+            } else if (a.best[p] >= k) {
+                // the parent survives this k, so this is the top of a cut subtree
+                Node* parent = a.nodes[p];
+                NodePtr& link = parent->left.get() == a.nodes[id] ? parent->left : parent->right;
+                garbage.push_back(std::move(link));
+            }
+        }
+        releaseSubtrees(garbage);
+        visit(k, root);
+    }
+}
+
+void truncate(NodePtr& root, long long k) {
+    truncateBatch(root, { k }, [](long long, const NodePtr&) {});
+}
+
+// Spiral (zigzag) order visits the tree level by level, alternating direction:
+// level 1 (the root's children) left to right, level 2 right to left, and so on.
+//
+// Both versions below keep one buffer for the current level and one for the
+// next, filled left to right; a right-to-left level is simply read backwards.
+// Memory is O(width) and the two buffers are reused from level to level.
+class SpiralIterator {
+public:
+    explicit SpiralIterator(NodePtr root) : root(root)
+    {
+        if (root) level.push_back(root.get());
+        startLevel();
+    }
+
+    // Returns the next node in spiral order, or nullptr when done.
+    const Node* next() {
+        if (remaining == 0) {
+            nextLevel.clear();
+            for (const Node* node : level)
+            {
+                if (node->left) nextLevel.push_back(node->left.get());
+                if (node->right) nextLevel.push_back(node->right.get());
+            }
+            level.swap(nextLevel);
+            depth++;
+            startLevel();
+            if (remaining == 0) return nullptr;
+        }
+        remaining--;
+        return leftToRight() ? level[level.size() - 1 - remaining] : level[remaining];
+    }
+
+private:
+    NodePtr root;
+    std::vector<const Node*> level;
+    std::vector<const Node*> nextLevel;
+    int depth = 0;
+    size_t remaining = 0;
+
+    bool leftToRight() const { return depth % 2 == 1; }
+    void startLevel() { remaining = level.size(); }
+};
+
+void printSpiral(NodePtr root) {
+    SpiralIterator it(root);
+    while (const Node* node = it.next()) {
+        std::cout << node->data << " ";
+    }
+}
+
+// Converts the tree into a doubly-linked list in spiral order by relinking 
+// the existing nodes: right becomes "next" and left becomes "previous". 
+// Children are moved out of their parent into the next-level buffer before 
+// the parent is relinked, so no node is allocated and reference counts only
+// change for the back links.
+//
+// Node only has shared_ptr links, so the back links form reference cycles:
+// release the list with releaseList rather than dropping the head.
+NodePtr spiralToList(NodePtr root) {
+    NodePtr head;
+    NodePtr* tailLink = &head;   // the shared_ptr that owns the current tail
+    if (!root) return head;
+
+    std::vector<NodePtr> level;
+    std::vector<NodePtr> nextLevel;
+    level.push_back(std::move(root));
+
+    for (int depth = 0; !level.empty(); depth++)
+    {
+        nextLevel.clear();
+        for (NodePtr& node : level)
+        {
+            if (node->left) nextLevel.push_back(std::move(node->left));
+            if (node->right) nextLevel.push_back(std::move(node->right));
+        }
+
+        bool leftToRight = depth % 2 == 1;
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            NodePtr& node = leftToRight ? level[i] : level[level.size() - 1 - i];
+            Node* tail = tailLink->get();
+            if (tail) {
+                node->left = *tailLink;
+                tail->right = std::move(node);
+                tailLink = &tail->right;
+            } else {
+                head = std::move(node);
+            }
+        }
+        level.swap(nextLevel);
+    }
+    return head;
+}
+
+void printList(NodePtr head) {
+    for (const Node* node = head.get(); node; node = node->right.get()) {
+        std::cout << node->data << " ";
+    }
+}
+
+// Breaks the back links and frees the list front to back without recursion.
+void releaseList(NodePtr& head) {
+    NodePtr curr = std::move(head);
+    while (curr)
+    {
+        curr->left.reset();
+        NodePtr next = std::move(curr->right);
+        curr = std::move(next);
+    }
+}
+
+void benchmarkSpiral(int n) {
+    NodePtr root = makeRandomTree(n);
+
+    long long sum = 0;
+    double iterate = timeMs([&] {
+        SpiralIterator it(root);
+        while (const Node* node = it.next()) sum += node->data;
+    });
+
+    NodePtr head;
+    double convert = timeMs([&] { head = spiralToList(std::move(root)); });
+    double release = timeMs([&] { releaseList(head); });
+
+    std::cout << "Spiral n=" << n << " (sum " << sum << ")\n"
+              << "  iterator:  " << iterate << " ms\n"
+              << "  to list:   " << convert << " ms\n"
+              << "  release:   " << release << " ms\n";
+}
+
+// Breadth-first search over a fixed ring buffer instead of std::queue: the 
+// buffer grows by doubling only when a level does not fit, and is otherwise
+// reused, so a BFS allocates O(log width) times at most.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity = 64) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        items.resize(cap);
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    void push(T value) {
+        if (count == items.size()) grow();
+        items[(head + count) & (items.size() - 1)] = value;
+        count++;
+    }
+
+    T pop() {
+        T value = items[head];
+        head = (head + 1) & (items.size() - 1);
+        count--;
+        return value;
+    }
+
+private:
+    std::vector<T> items;
+    size_t head = 0;
+    size_t count = 0;
+
+    void grow() {
+        std::vector<T> bigger(items.size() * 2);
+        for (size_t i = 0; i < count; i++) bigger[i] = items[(head + i) & (items.size() - 1)];
+        items.swap(bigger);
+        head = 0;
+    }
+};
+
+// The minimum depth is the number of nodes on the shortest path from the 
+// root to a leaf. BFS reaches the shallowest leaf before any deeper node, so 
+// the search stops there and never looks below it.
+int minDepth(NodePtr root) {
+    if (!root) return 0;
+
+    RingBuffer<const Node*> queue;
+    queue.push(root.get());
+
+    for (int depth = 1; ; depth++)
+    {
+        for (size_t i = queue.size(); i > 0; i--)
+        {
+            const Node* curr = queue.pop();
+            if (!curr->left && !curr->right) return depth;
+
+            if (curr->left) queue.push(curr->left.get());
+            if (curr->right) queue.push(curr->right.get());
+        }
+    }
+}
+
+struct LevelWidth {
+    int width = 0;      // number of nodes on the widest level
+    int level = 0;      // first level with that many nodes (root is 0)
+};
+
+// Maximum number of nodes at any level. The queue holds at most two levels 
+// at a time and only the running count per level is kept.
+LevelWidth maxWidth(NodePtr root) {
+    LevelWidth best;
+    if (!root) return best;
+
+    RingBuffer<const Node*> queue;
+    queue.push(root.get());
+
+    for (int level = 0; !queue.empty(); level++)
+    {
+        int count = (int)queue.size();
+        if (count > best.width) best = { count, level };
+
+        for (int i = 0; i < count; i++)
+        {
+            const Node* curr = queue.pop();
+            if (curr->left) queue.push(curr->left.get());
+            if (curr->right) queue.push(curr->right.get());
+        }
+    }
+    return best;
+}
+
+// Level-synchronous variant for very wide trees: each level is split into 
+// slices, each thread collects the children of its slice, and the slices are
+// concatenated in order to form the next level.
+LevelWidth maxWidthParallel(NodePtr root, int threads = (int)std::thread::hardware_concurrency()) {
+    LevelWidth best;
+    if (!root) return best;
+    threads = std::max(threads, 1);
+
+    std::vector<const Node*> level = { root.get() };
+    std::vector<std::vector<const Node*>> parts(threads);
+
+    for (int depth = 0; !level.empty(); depth++)
+    {
+        if ((int)level.size() > best.width) best = { (int)level.size(), depth };
+
+        size_t chunk = (level.size() + threads - 1) / threads;
+        auto collect = [&](int t) {
+            parts[t].clear();
+            size_t end = std::min(level.size(), (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; i++)
+            {
+                if (level[i]->left) parts[t].push_back(level[i]->left.get());
+                if (level[i]->right) parts[t].push_back(level[i]->right.get());
+            }
+        };
+
+        // narrow levels are not worth a thread each
+        if (level.size() < 4096) {
+            for (int t = 0; t < threads; t++) collect(t);
+        } else {
+            std::vector<std::thread> pool;
+            for (int t = 1; t < threads; t++) pool.emplace_back(collect, t);
+            collect(0);
+            for (auto& th : pool) th.join();
+        }
+
+        level.clear();
+        for (auto& part : parts) level.insert(level.end(), part.begin(), part.end());
+    }
+    return best;
+}
+
+// Storing words in a binary tree: a string-keyed AVL tree. Nodes live in one
+// vector and refer to each other by index, and so do keys: a word of up to 
+// 12 characters is stored inline in its node, longer words are appended to a
+// single character arena and the node keeps their offset. Millions of words 
+// therefore cost two growing buffers instead of one allocation per node plus
+// one per string.
+class WordTree {
+public:
+    // Returns false if the word was already present.
+    bool insert(std::string_view word) {
+        bool added = false;
+        root = insert(root, word, added);
+        return added;
+    }
+
+    bool contains(std::string_view word) const {
+        int curr = root;
+        while (curr >= 0)
+        {
+            int cmp = word.compare(key(curr));
+            if (cmp == 0) return true;
+            curr = cmp < 0 ? nodes[curr].left : nodes[curr].right;
+        }
+        return false;
+    }
+
+    size_t size() const { return nodes.size(); }
+
+    // Calls visit(word) for every stored word starting with prefix, in order.
+    // The walk starts at the first key >= prefix and stops at the first key 
+    // that no longer has the prefix, so it only touches matching nodes and 
+    // the O(log n) nodes on the way down.
+    template <typename Visit>
+    void forEachWithPrefix(std::string_view prefix, Visit visit) const {
+        std::vector<int> stack;
+        int curr = root;
+        while (curr >= 0)
+        {
+            if (key(curr).compare(prefix) >= 0) {
+                stack.push_back(curr);
+                curr = nodes[curr].left;
+            } else {
+                curr = nodes[curr].right;
+            }
+        }
+
+        while (!stack.empty())
+        {
+            curr = stack.back();
+            stack.pop_back();
+
+            std::string_view word = key(curr);
+            if (word.substr(0, prefix.size()) != prefix) return;
+            visit(word);
+
+            for (int next = nodes[curr].right; next >= 0; next = nodes[next].left)
+            {
+                stack.push_back(next);
+            }
+        }
+    }
+
+    void printWithPrefix(std::string_view prefix) const {
+        forEachWithPrefix(prefix, [](std::string_view word) { std::cout << word << " "; });
+    }
+
+private:
+    static const uint32_t inlineCapacity = 12;
+
+    struct WordNode {
+        uint32_t size;
+        union {
+            char chars[inlineCapacity];
+            uint64_t offset;
+        };
+        int left = -1;
+        int right = -1;
+        int height = 1;
+    };
+
+    std::vector<WordNode> nodes;
+    std::vector<char> arena;
+    int root = -1;
+
+    std::string_view key(int id) const {
+        const WordNode& n = nodes[id];
+        const char* chars = n.size <= inlineCapacity ? n.chars : arena.data() + n.offset;
+        return std::string_view(chars, n.size);
+    }
+
+    int newNode(std::string_view word) {
+        WordNode n;
+        n.size = (uint32_t)word.size();
+        if (word.size() <= inlineCapacity) {
+            std::copy(word.begin(), word.end(), n.chars);
+        } else {
+            n.offset = arena.size();
+            arena.insert(arena.end(), word.begin(), word.end());
+        }
+        nodes.push_back(n);
+        return (int)nodes.size() - 1;
+    }
+
+    int heightOf(int id) const { return id < 0 ? 0 : nodes[id].height; }
+
+    void update(int id) {
+        nodes[id].height = std::max(heightOf(nodes[id].left), heightOf(nodes[id].right)) + 1;
+    }
+
+    int rotateRight(int id) {
+        int l = nodes[id].left;
+        nodes[id].left = nodes[l].right;
+        nodes[l].right = id;
+        update(id);
+        update(l);
+        return l;
+    }
+
+    int rotateLeft(int id) {
+        int r = nodes[id].right;
+        nodes[id].right = nodes[r].left;
+        nodes[r].left = id;
+        update(id);
+        update(r);
+        return r;
+    }
+
+    int rebalance(int id) {
+        update(id);
+        int balance = heightOf(nodes[id].left) - heightOf(nodes[id].right);
+        if (balance > 1) {
+            if (heightOf(nodes[nodes[id].left].left) < heightOf(nodes[nodes[id].left].right)) {
+                nodes[id].left = rotateLeft(nodes[id].left);
+            }
+            return rotateRight(id);
+        }
+        if (balance < -1) {
+            if (heightOf(nodes[nodes[id].right].right) < heightOf(nodes[nodes[id].right].left)) {
+                nodes[id].right = rotateRight(nodes[id].right);
+            }
+            return rotateLeft(id);
+        }
+        return id;
+    }
+
+    // AVL height is at most ~1.44 log2(n), so recursion stays shallow.
+    int insert(int id, std::string_view word, bool& added) {
+        if (id < 0) {
+            added = true;
+            return newNode(word);
+        }
+        int cmp = word.compare(key(id));
+        if (cmp == 0) return id;
+        if (cmp < 0) {
+            int child = insert(nodes[id].left, word, added);
+            nodes[id].left = child;
+        } else {
+            int child = insert(nodes[id].right, word, added);
+            nodes[id].right = child;
+        }
+        return added ? rebalance(id) : id;
+    }
+};
+
+void benchmarkWords(int n) {
+    std::mt19937 rng(3);
+    std::vector<std::string> words(n);
+    for (auto& w : words)
+    {
+        w.resize(3 + rng() % 18);
+        for (char& c : w) c = (char)('a' + rng() % 26);
+    }
+
+    WordTree tree;
+    std::set<std::string> set;
+    double insertTree = timeMs([&] { for (auto& w : words) tree.insert(w); });
+    double insertSet = timeMs([&] { for (auto& w : words) set.insert(w); });
+
+    size_t foundTree = 0, foundSet = 0;
+    double findTree = timeMs([&] { for (auto& w : words) foundTree += tree.contains(w); });
+    double findSet = timeMs([&] { for (auto& w : words) foundSet += set.count(w); });
+
+    size_t prefixTree = 0, prefixSet = 0;
+    int scans = std::min(n, 1000);
+    double scanTree = timeMs([&] {
+        for (int i = 0; i < scans; i++)
+        {
+            tree.forEachWithPrefix(std::string_view(words[i]).substr(0, 2), 
+                                   [&](std::string_view) { prefixTree++; });
+        }
+    });
+    double scanSet = timeMs([&] {
+        for (int i = 0; i < scans; i++)
+        {
+            std::string prefix = words[i].substr(0, 2);
+            for (auto it = set.lower_bound(prefix); it != set.end() && it->compare(0, 2, prefix) == 0; ++it)
+            {
+                prefixSet++;
+            }
+        }
+    });
+
+    std::cout << "Words n=" << n << " (" << tree.size() << " distinct)\n"
+              << "  insert: tree " << insertTree << " ms, std::set " << insertSet << " ms\n"
+              << "  lookup: tree " << findTree << " ms, std::set " << findSet << " ms"
+              << (foundTree == foundSet ? "" : " MISMATCH") << "\n"
+              << "  prefix: tree " << scanTree << " ms, std::set " << scanSet << " ms"
+              << (prefixTree == prefixSet ? "" : " MISMATCH") << "\n";
+}
+
+// Given a sequence of digits, find every word formed by replacing runs of one
+// or two consecutive digits with the letter at that position in the alphabet:
+// 1 -> A, ..., 9 -> I, 10 -> J, ..., 26 -> Z. A 0 can only appear as the 
+// second digit of 10 or 20.
+//
+// The number of words grows like the Fibonacci numbers, so counting and 
+// enumerating are kept separate. ways(i), the number of decodings of the 
+// digits from position i on, satisfies
+//      ways(i) = ways(i + 1) [if digit i is 1..9] + ways(i + 2) [if digits i, i+1 are 10..26]
+// which gives the count in O(n) without producing any word. The entry points
+// below throw std::invalid_argument for values outside 0..9.
+void requireDigits(const std::vector<int>& digits) {
+    for (int d : digits)
+    {
+        if (d < 0 || d > 9) throw std::invalid_argument("decodings: every value must be a digit 0..9");
+    }
+}
+
+bool decodesAlone(const std::vector<int>& digits, size_t i) {
+    return digits[i] >= 1 && digits[i] <= 9;
+}
+
+bool decodesAsPair(const std::vector<int>& digits, size_t i) {
+    if (i + 1 >= digits.size()) return false;
+    int value = digits[i] * 10 + digits[i + 1];
+    return value >= 10 && value <= 26;
+}
+
+// The count outgrows 64 bits at roughly 90 digits made of 1s and 2s. Past
+// that point count stays at the maximum unsigned long long and exact is 
+// false; use the modular overload below for exact results on long inputs.
+struct DecodingCount {
+    unsigned long long count = 0;
+    bool exact = true;
+};
+
+DecodingCount countDecodings(const std::vector<int>& digits) {
+    requireDigits(digits);
+    const unsigned long long limit = std::numeric_limits<unsigned long long>::max();
+    DecodingCount next = { 1, true }, nextNext = { 0, true };   // ways(i + 1), ways(i + 2)
+
+    for (size_t i = digits.size(); i-- > 0;)
+    {
+        DecodingCount ways;
+        if (decodesAlone(digits, i)) ways = next;
+        if (decodesAsPair(digits, i)) {
+            ways.exact = ways.exact && nextNext.exact && nextNext.count <= limit - ways.count;
+            ways.count = ways.exact ? ways.count + nextNext.count : limit;
+        }
+        nextNext = next;
+        next = ways;
+    }
+    return next;
+}
+
+// The number of decodings modulo `modulus`, exact for inputs of any length.
+// Throws std::invalid_argument for a zero modulus.
+unsigned long long countDecodings(const std::vector<int>& digits, unsigned long long modulus) {
+    if (modulus == 0) throw std::invalid_argument("countDecodings: modulus must be positive");
+    requireDigits(digits);
+    unsigned long long next = 1 % modulus, nextNext = 0;
+
+    for (size_t i = digits.size(); i-- > 0;)
+    {
+        unsigned long long ways = 0;
+        if (decodesAlone(digits, i)) ways = next;
+        if (decodesAsPair(digits, i)) {
+            // (ways + nextNext) % modulus without overflowing
+            ways = ways >= modulus - nextNext ? ways - (modulus - nextNext) : ways + nextNext;
+        }
+        nextNext = next;
+        next = ways;
+    }
+    return next;
+}
+
+// Streams every decoding, in alphabetical order, to visit(std::string_view).
+// One buffer holds the word being built and is passed to visit by view, so 
+// nothing is allocated per word. The search is an explicit-stack DFS (safe 
+// for long inputs) that only takes a step if the rest of the digits can still
+// be decoded, so it never explores a dead end.
+template <typename Visit>
+void forEachDecoding(const std::vector<int>& digits, Visit visit) {
+    requireDigits(digits);
+    size_t n = digits.size();
+    std::vector<char> viable(n + 2, 0);
+    viable[n] = 1;
+    for (size_t i = n; i-- > 0;)
+    {
+        viable[i] = (decodesAlone(digits, i) && viable[i + 1]) 
+                 || (decodesAsPair(digits, i) && viable[i + 2]);
+    }
+    if (!viable[0]) return;
+
+    std::string word;
+    std::vector<char> steps;    // digits consumed by each letter of word
+    word.reserve(n);
+    steps.reserve(n);
+    size_t pos = 0;
+
+    // takes the first viable step of at least `from` digits at pos
+    auto step = [&](int from) {
+        for (int len = from; len <= 2; len++)
+        {
+            bool ok = len == 1 ? decodesAlone(digits, pos) : decodesAsPair(digits, pos);
+            if (ok && viable[pos + len]) {
+                int value = len == 1 ? digits[pos] : digits[pos] * 10 + digits[pos + 1];
+                word.push_back((char)('A' + value - 1));
+                steps.push_back((char)len);
+                pos += len;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    while (true)
+    {
+        while (pos < n) step(1);
+        visit(std::string_view(word));
+
+        // backtrack to the last letter that can take a longer step
+        bool advanced = false;
+        while (!steps.empty() && !advanced)
+        {
+            int len = steps.back();
+            steps.pop_back();
+            word.pop_back();
+            pos -= len;
+            advanced = step(len + 1);
+        }
+        if (!advanced) return;
+    }
+}
+
+void printDecodings(const std::vector<int>& digits) {
+    forEachDecoding(digits, [](std::string_view word) { std::cout << word << " "; });
+}
+
+// Rebuilding helpers shared by the balanced trees below.
+// flattenInorder moves the nodes of a subtree, in order, into out and clears
+// their child links; buildBalanced relinks out[lo, hi) into a perfectly 
+// balanced subtree (middle node as the root). Nodes are reused as they are,
+// so neither allocates a node or touches a reference count.
+void flattenInorder(NodePtr node, std::vector<NodePtr>& out) {
+    std::vector<NodePtr> stack;
+    while (node || !stack.empty())
+    {
+        while (node)
+        {
+            NodePtr left = std::move(node->left);
+            stack.push_back(std::move(node));
+            node = std::move(left);
+        }
+        node = std::move(stack.back());
+        stack.pop_back();
+
+        NodePtr right = std::move(node->right);
+        out.push_back(std::move(node));
+        node = std::move(right);
+    }
+}
+
+NodePtr buildBalanced(std::vector<NodePtr>& nodes, size_t lo, size_t hi) {
+    if (lo >= hi) return nullptr;
+    size_t mid = lo + (hi - lo) / 2;
+    NodePtr node = std::move(nodes[mid]);
+    node->left = buildBalanced(nodes, lo, mid);
+    node->right = buildBalanced(nodes, mid + 1, hi);
+    return node;
+}
+
+size_t countNodes(const Node* root) {
+    if (!root) return 0;
+    size_t count = 0;
+    std::vector<const Node*> stack = { root };
+    while (!stack.empty())
+    {
+        const Node* curr = stack.back();
+        stack.pop_back();
+        count++;
+        if (curr->left) stack.push_back(curr->left.get());
+        if (curr->right) stack.push_back(curr->right.get());
+    }
+    return count;
+}
+
+// Order statistics. With the size of every subtree known, the k-th node in 
+// inorder is found by comparing k with the size of the left subtree at each 
+// step down, so select, rank and inorder ranges cost O(height) instead of a
+// full inorderIterative walk. Node has no room for the sizes, so they are 
+// kept in a side table keyed by node; build fills it in one postorder pass 
+// (the same shape as sumPostorder, without touching Node::data) and 
+// BalancedTree keeps it up to date on insert and erase.
+class SubtreeSizes {
+public:
+    // (Re)computes the sizes of every node under root.
+    size_t build(const NodePtr& root) {
+        if (!root) return 0;
+
+        std::vector<std::pair<const Node*, bool>> stack;
+        stack.push_back({root.get(), false});
+        while (!stack.empty())
+        {
+            auto [curr, expanded] = stack.back();
+            stack.pop_back();
+
+            if (expanded) {
+                sizes[curr] = size(curr->left.get()) + size(curr->right.get()) + 1;
+            } else {
+                stack.push_back({curr, true});
+                if (curr->right) stack.push_back({curr->right.get(), false});
+                if (curr->left) stack.push_back({curr->left.get(), false});
+            }
+        }
+        return sizes[root.get()];
+    }
+
+    size_t size(const Node* node) const {
+        if (!node) return 0;
+        auto it = sizes.find(node);
+        return it == sizes.end() ? 0 : it->second;
+    }
+
+    void set(const Node* node, size_t size) { sizes[node] = size; }
+    void add(const Node* node, long long delta) { sizes[node] += delta; }
+    void forget(const Node* node) { sizes.erase(node); }
+    void clear() { sizes.clear(); }
+
+    // The k-th node in inorder (0-based), or nullptr if k is out of range.
+    // Throws std::logic_error if root was never build()-ed.
+    NodePtr select(const NodePtr& root, size_t k) const {
+        requireBuilt(root);
+        const NodePtr* link = &root;
+        while (*link)
+        {
+            size_t left = size((*link)->left.get());
+            if (k == left) return *link;
+            if (k < left) {
+                link = &(*link)->left;
+            } else {
+                k -= left + 1;
+                link = &(*link)->right;
+            }
+        }
+        return nullptr;
+    }
+
+    // Calls visit(node) for the nodes at inorder positions [i, j). Descending
+    // to position i leaves exactly the ancestors still to be visited on the 
+    // stack, after which it is a plain iterative inorder walk. Throws 
+    // std::logic_error if root was never build()-ed.
+    template <typename Visit>
+    void forEachInorderRange(const NodePtr& root, size_t i, size_t j, Visit visit) const {
+        requireBuilt(root);
+        std::vector<const Node*> stack;
+        const Node* curr = root.get();
+        size_t k = i;
+        while (curr)
+        {
+            size_t left = size(curr->left.get());
+            if (k <= left) {
+                stack.push_back(curr);
+                if (k == left) break;
+                curr = curr->left.get();
+            } else {
+                k -= left + 1;
+                curr = curr->right.get();
+            }
+        }
+
+        for (size_t pos = i; pos < j && !stack.empty(); pos++)
+        {
+            curr = stack.back();
+            stack.pop_back();
+            visit(curr);
+            for (const Node* next = curr->right.get(); next; next = next->left.get()) stack.push_back(next);
+        }
+    }
+
+private:
+    std::unordered_map<const Node*, size_t> sizes;
+
+    // A missing node would count as an empty subtree and skew every answer.
+    void requireBuilt(const NodePtr& root) const {
+        if (root && !sizes.count(root.get())) {
+            throw std::logic_error("SubtreeSizes: tree was not built");
+        }
+    }
+};
+
+// Subtree aggregates. sumPostorder computes one aggregate (the sum) and 
+// stores it over Node::data. More generally, any monoid - an associative 
+// combine with an identity - can be cached per node as
+//      agg(node) = combine(agg(left), lift(node->data), agg(right))
+// A monoid is a type with a Value type and static identity(), lift(int) and
+// combine(Value, Value) members, like the ones below. SubtreeSizes above is
+// the Count case specialised for rank/select.
+struct SumMonoid {
+    using Value = long long;
+    static Value identity() { return 0; }
+    static Value lift(int data) { return data; }
+    static Value combine(Value a, Value b) { return a + b; }
+};
+
+struct MinMonoid {
+    using Value = int;
+    static Value identity() { return std::numeric_limits<int>::max(); }
+    static Value lift(int data) { return data; }
+    static Value combine(Value a, Value b) { return std::min(a, b); }
+};
+
+struct MaxMonoid {
+    using Value = int;
+    static Value identity() { return std::numeric_limits<int>::min(); }
+    static Value lift(int data) { return data; }
+    static Value combine(Value a, Value b) { return std::max(a, b); }
+};
+
+struct CountMonoid {
+    using Value = size_t;
+    static Value identity() { return 0; }
+    static Value lift(int) { return 1; }
+    static Value combine(Value a, Value b) { return a + b; }
+};
+
+struct XorMonoid {
+    using Value = int;
+    static Value identity() { return 0; }
+    static Value lift(int data) { return data; }
+    static Value combine(Value a, Value b) { return a ^ b; }
+};
+
+// Receives structural changes from BalancedTree so that side tables keyed 
+// by node stay current.
+struct TreeObserver {
+    virtual ~TreeObserver() = default;
+    // path lists, root first, every node whose subtree changed
+    virtual void pathChanged(const std::vector<Node*>& path) = 0;
+    virtual void removed(const Node* node) = 0;
+    // every node under subtree was relinked
+    virtual void rebuilt(const NodePtr& subtree) = 0;
+};
+
+// Caches Monoid aggregates per node in a side table. build() fills it in one
+// iterative postorder pass; after a change only the nodes on the path from 
+// the root to it are recomputed, bottom-up. On a binary search tree, query()
+// aggregates the values in a key range in O(height).
+template <typename Monoid>
+class SubtreeAggregates : public TreeObserver {
+public:
+    using Value = typename Monoid::Value;
+
+    Value build(const NodePtr& root) {
+        if (!root) return Monoid::identity();
+
+        std::vector<std::pair<const Node*, bool>> stack;
+        stack.push_back({root.get(), false});
+        while (!stack.empty())
+        {
+            auto [curr, expanded] = stack.back();
+            stack.pop_back();
+
+            if (expanded) {
+                refresh(curr);
+            } else {
+                stack.push_back({curr, true});
+                if (curr->right) stack.push_back({curr->right.get(), false});
+                if (curr->left) stack.push_back({curr->left.get(), false});
+            }
+        }
+        return get(root.get());
+    }
+
+    Value get(const Node* node) const {
+        if (!node) return Monoid::identity();
+        auto it = values.find(node);
+        return it == values.end() ? Monoid::identity() : it->second;
+    }
+
+    // Recomputes one node from its (already current) children.
+    void refresh(const Node* node) {
+        values[node] = Monoid::combine(Monoid::combine(get(node->left.get()), Monoid::lift(node->data)), 
+                                       get(node->right.get()));
+    }
+
+    void pathChanged(const std::vector<Node*>& path) override {
+        for (auto it = path.rbegin(); it != path.rend(); ++it) refresh(*it);
+    }
+
+    void removed(const Node* node) override { values.erase(node); }
+
+    void rebuilt(const NodePtr& subtree) override { build(subtree); }
+
+    // Aggregate of the values in [lo, hi), in order, for a binary search tree.
+    Value query(const NodePtr& root, int lo, int hi) const {
+        // the first node inside the range is the root of every node in it
+        const Node* split = root.get();
+        while (split && (split->data < lo || split->data >= hi))
+        {
+            split = split->data < lo ? split->right.get() : split->left.get();
+        }
+        if (!split) return Monoid::identity();
+
+        // left of split: a node >= lo comes with its whole right subtree,
+        // and all of it goes after what is still to be found further left
+        Value left = Monoid::identity();
+        for (const Node* curr = split->left.get(); curr;)
+        {
+            if (curr->data >= lo) {
+                left = Monoid::combine(Monoid::combine(Monoid::lift(curr->data), get(curr->right.get())), left);
+                curr = curr->left.get();
+            } else {
+                curr = curr->right.get();
+            }
+        }
+
+        Value right = Monoid::identity();
+        for (const Node* curr = split->right.get(); curr;)
+        {
+            if (curr->data < hi) {
+                right = Monoid::combine(right, Monoid::combine(get(curr->left.get()), Monoid::lift(curr->data)));
+                curr = curr->right.get();
+            } else {
+                curr = curr->left.get();
+            }
+        }
+
+        return Monoid::combine(Monoid::combine(left, Monoid::lift(split->data)), right);
+    }
+
+private:
+    std::unordered_map<const Node*, Value> values;
+};
+
+// A binary search tree with guaranteed O(log n) height, built from plain Node
+// objects so that root() can be handed to every traversal and view function
+// above. Red-black and AVL trees need a color or height in every node, which
+// Node does not have; a scapegoat tree needs no per-node bookkeeping at all.
+//
+// The tree stays alpha-weight-balanced: its height never exceeds
+// log(n) / log(1 / alpha). When an insert lands deeper than that, the path 
+// back up contains a "scapegoat" whose child holds more than alpha of its 
+// nodes, and that subtree is flattened and rebuilt perfectly balanced. After
+// enough erases the whole tree is rebuilt. Both are amortized O(log n).
+//
+// Order statistics are optional: after enableOrderStatistics() the subtree 
+// sizes are maintained on every insert, erase and rebuild, and select/rank 
+// become available; before that they throw std::logic_error. Other side tables, such as SubtreeAggregates, can follow
+// the same changes through addObserver().
+class BalancedTree {
+public:
+    // alpha must lie in (0.5, 1): at 0.5 or below no child can ever be heavy
+    // enough to be a scapegoat, and at 1 the height bound is infinite.
+    explicit BalancedTree(double alpha = 0.7) : alpha(alpha)
+    {
+        if (!(alpha > 0.5 && alpha < 1)) throw std::invalid_argument("BalancedTree: alpha must be in (0.5, 1)");
+    }
+
+    NodePtr root() const { return top; }
+    size_t size() const { return count; }
+
+    void enableOrderStatistics() {
+        trackSizes = true;
+        sizes.clear();
+        sizes.build(top);
+    }
+
+    // The observer is brought up to date with the current tree right away.
+    void addObserver(TreeObserver* observer) {
+        observers.push_back(observer);
+        if (top) observer->rebuilt(top);
+    }
+
+    // The k-th smallest value's node (0-based); requires order statistics.
+    NodePtr select(size_t k) const {
+        requireOrderStatistics();
+        return sizes.select(top, k);
+    }
+
+    // Number of values smaller than value; requires order statistics.
+    size_t rank(int value) const {
+        requireOrderStatistics();
+        size_t less = 0;
+        for (const Node* curr = top.get(); curr;)
+        {
+            if (value <= curr->data) {
+                curr = curr->left.get();
+            } else {
+                less += sizes.size(curr->left.get()) + 1;
+                curr = curr->right.get();
+            }
+        }
+        return less;
+    }
+
+    size_t rank(const NodePtr& node) const { return rank(node->data); }
+
+    // Calls visit(node) for the nodes of rank [i, j); requires order statistics.
+    template <typename Visit>
+    void forEachInRankRange(size_t i, size_t j, Visit visit) const {
+        requireOrderStatistics();
+        sizes.forEachInorderRange(top, i, j, visit);
+    }
+
+    NodePtr find(int value) const {
+        const NodePtr* link = &top;
+        while (*link && (*link)->data != value)
+        {
+            link = value < (*link)->data ? &(*link)->left : &(*link)->right;
+        }
+        return *link;
+    }
+
+    bool contains(int value) const { return find(value) != nullptr; }
+
+    // Returns false if the value was already present.
+    bool insert(int value) {
+        std::vector<NodePtr*> path;    // links from the root down to the new node
+        NodePtr* link = &top;
+        while (*link)
+        {
+            if ((*link)->data == value) return false;
+            path.push_back(link);
+            link = value < (*link)->data ? &(*link)->left : &(*link)->right;
+        }
+        *link = std::make_shared<Node>(value);
+        path.push_back(link);
+        count++;
+        if (trackSizes) {
+            for (NodePtr* ancestor : path) sizes.add(ancestor->get(), 1);
+        }
+        if (!observers.empty()) {
+            std::vector<Node*> changed;
+            for (NodePtr* ancestor : path) changed.push_back(ancestor->get());
+            for (TreeObserver* observer : observers) observer->pathChanged(changed);
+        }
+        maxCount = std::max(maxCount, count);
+
+        int depth = (int)path.size() - 1;
+        if (depth > maxHeight(count)) {
+            // walk back up until a child is too heavy for its parent
+            size_t childSize = 1;
+            for (int i = depth - 1; i >= 0; i--)
+            {
+                Node* parent = path[i]->get();
+                const Node* child = path[i + 1]->get();
+                const Node* sibling = parent->left.get() == child ? parent->right.get() : parent->left.get();
+                size_t siblingSize = trackSizes ? sizes.size(sibling) : countNodes(sibling);
+                size_t parentSize = childSize + siblingSize + 1;
+
+                if (childSize > alpha * parentSize) {
+                    rebuild(*path[i], parentSize);
+                    break;
+                }
+                childSize = parentSize;
+            }
+        }
+        return true;
+    }
+
+    // Returns false if the value was not present.
+    bool erase(int value) {
+        std::vector<Node*> path;    // ancestors of the node that gets unlinked
+        NodePtr* link = &top;
+        while (*link && (*link)->data != value)
+        {
+            path.push_back(link->get());
+            link = value < (*link)->data ? &(*link)->left : &(*link)->right;
+        }
+        if (!*link) return false;
+
+        Node* node = link->get();
+        if (node->left && node->right) {
+            // take the value of the inorder successor and unlink that instead
+            path.push_back(node);
+            NodePtr* successor = &node->right;
+            while ((*successor)->left)
+            {
+                path.push_back(successor->get());
+                successor = &(*successor)->left;
+            }
+            node->data = (*successor)->data;
+            link = successor;
+        }
+        NodePtr removed = std::move(*link);
+        *link = removed->left ? std::move(removed->left) : std::move(removed->right);
+        count--;
+        if (trackSizes) {
+            sizes.forget(removed.get());
+            for (Node* ancestor : path) sizes.add(ancestor, -1);
+        }
+        for (TreeObserver* observer : observers)
+        {
+            observer->removed(removed.get());
+            observer->pathChanged(path);
+        }
+
+        if (count < alpha * maxCount) {
+            rebuild(top, count);
+            maxCount = count;
+        }
+        return true;
+    }
+
+private:
+    NodePtr top;
+    double alpha;
+    size_t count = 0;
+    size_t maxCount = 0;
+    bool trackSizes = false;
+    SubtreeSizes sizes;
+    std::vector<TreeObserver*> observers;
+
+    void requireOrderStatistics() const {
+        if (!trackSizes) throw std::logic_error("BalancedTree: call enableOrderStatistics() first");
+    }
+
+    int maxHeight(size_t n) const {
+        return (int)(std::log((double)n) / std::log(1.0 / alpha));
+    }
+
+    void rebuild(NodePtr& subtree, size_t size) {
+        std::vector<NodePtr> nodes;
+        nodes.reserve(size);
+        flattenInorder(std::move(subtree), nodes);
+        subtree = buildBalanced(nodes, 0, nodes.size());
+        if (trackSizes) sizes.build(subtree);
+        for (TreeObserver* observer : observers) observer->rebuilt(subtree);
+    }
+};
+
+void benchmarkBalancedTree(int n) {
+    std::mt19937 rng(11);
+    std::vector<int> values(n);
+    for (int& v : values) v = (int)(rng() % (4u * n));
+
+    BalancedTree tree;
+    std::set<int> set;
+    double insertTree = timeMs([&] { for (int v : values) tree.insert(v); });
+    double insertSet = timeMs([&] { for (int v : values) set.insert(v); });
+
+    size_t foundTree = 0, foundSet = 0;
+    double findTree = timeMs([&] { for (int v : values) foundTree += tree.contains(v + 1); });
+    double findSet = timeMs([&] { for (int v : values) foundSet += set.count(v + 1); });
+
+    double eraseTree = timeMs([&] { for (int i = 0; i < n; i += 2) tree.erase(values[i]); });
+    double eraseSet = timeMs([&] { for (int i = 0; i < n; i += 2) set.erase(values[i]); });
+
+    std::cout << "Balanced tree n=" << n << " (height " << height(tree.root()) + 1 
+              << ", size " << tree.size() << (tree.size() == set.size() ? "" : " MISMATCH") << ")\n"
+              << "  insert: tree " << insertTree << " ms, std::set " << insertSet << " ms\n"
+              << "  find:   tree " << findTree << " ms, std::set " << findSet << " ms"
+              << (foundTree == foundSet ? "" : " MISMATCH") << "\n"
+              << "  erase:  tree " << eraseTree << " ms, std::set " << eraseSet << " ms\n";
+}
+
+// A binary tree reads one node, and usually one cache line, per level. This 
+// B+-tree keeps up to 16 keys per node in a single 64-byte line, so a lookup
+// in a million keys goes through about 5 nodes instead of 20+. The keys of a
+// node are compared against the target all at once with SSE2 when it is 
+// available (unused slots hold INT_MAX so the full line can be compared).
+//
+// Leaves and inner nodes have separate layouts. A leaf is just its key line;
+// the key counts and the links to the next leaf sit in side arrays that only
+// inserts and scans read. An inner node is its key line followed by a line of
+// child indices, so a lookup reads two lines per inner level and one at the
+// leaf. Values live only in the leaves, which are chained left to right, so 
+// inorder iteration and range scans walk contiguous key arrays.
+class BPlusTree {
+public:
+    static const int order = 16;     // key slots per node
+
+    // Returns false if the key was already present.
+    bool insert(int key) {
+        if (root < 0) root = newLeaf();
+
+        Split split;
+        bool added = insert(root, levels, key, split);
+        if (split.right >= 0) {
+            int top = newInner();
+            inners[top].keys[0] = split.key;
+            inners[top].children[0] = root;
+            inners[top].children[1] = split.right;
+            inners[top].count = 1;
+            root = top;
+            levels++;
+        }
+        if (added) count++;
+        return added;
+    }
+
+    bool contains(int key) const {
+        if (root < 0) return false;
+        int leaf = findLeaf(key);
+        int pos = countLess(leafKeys[leaf].keys, key);
+        // a stored INT_MAX is the only key that can be confused with padding
+        if (key == std::numeric_limits<int>::max() && pos >= leafCount[leaf]) return false;
+        return pos < order && leafKeys[leaf].keys[pos] == key;
+    }
+
+    size_t size() const { return count; }
+
+    // Calls visit(key) for every key in [lo, hi), in order.
+    template <typename Visit>
+    void forEachInRange(int lo, int hi, Visit visit) const {
+        if (root < 0) return;
+        int leaf = findLeaf(lo);
+        int pos = countLess(leafKeys[leaf].keys, lo);
+        for (; leaf >= 0; leaf = leafNext[leaf], pos = 0)
+        {
+            for (; pos < leafCount[leaf]; pos++)
+            {
+                if (leafKeys[leaf].keys[pos] >= hi) return;
+                visit(leafKeys[leaf].keys[pos]);
+            }
+        }
+    }
+
+    template <typename Visit>
+    void forEachInorder(Visit visit) const {
+        if (root < 0) return;
+        int leaf = root;
+        for (int level = levels; level > 0; level--) leaf = inners[leaf].children[0];
+        for (; leaf >= 0; leaf = leafNext[leaf])
+        {
+            for (int i = 0; i < leafCount[leaf]; i++) visit(leafKeys[leaf].keys[i]);
+        }
+    }
+
+private:
+    struct alignas(64) KeyLine {
+        int keys[order];
+
+        KeyLine() { std::fill(keys, keys + order, std::numeric_limits<int>::max()); }
+    };
+    static_assert(sizeof(KeyLine) == 64, "a leaf must be exactly one cache line");
+
+    // Nodes split as soon as they reach 16 keys, so between inserts an inner
+    // node uses at most 16 children, all within the line after its keys.
+    struct alignas(64) Inner {
+        int keys[order];
+        int children[order + 1];
+        int count = 0;
+
+        Inner() { std::fill(keys, keys + order, std::numeric_limits<int>::max()); }
+    };
+
+    struct Split {
+        int key = 0;        // first key reachable through right
+        int right = -1;
+    };
+
+    std::vector<KeyLine> leafKeys;
+    std::vector<int> leafCount;
+    std::vector<int> leafNext;          // the leaf to the right, -1 for the last
+    std::vector<Inner> inners;
+    int root = -1;
+    int levels = 0;                     // inner levels above the leaves
+    size_t count = 0;
+
+    int newLeaf() {
+        leafKeys.emplace_back();
+        leafCount.push_back(0);
+        leafNext.push_back(-1);
+        return (int)leafKeys.size() - 1;
+    }
+
+    int newInner() {
+        inners.emplace_back();
+        return (int)inners.size() - 1;
+    }
+
+    // number of keys in the line smaller than key
+    static int countLess(const int* keys, int key) {
+#if defined(__SSE2__)
+        __m128i target = _mm_set1_epi32(key);
+        int less = 0;
+        for (int i = 0; i < order; i += 4)
+        {
+            __m128i k = _mm_load_si128((const __m128i*)(keys + i));
+            less += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(target, k))));
+        }
+        return less;
+#else
+        int less = 0;
+        for (int i = 0; i < order; i++) less += keys[i] < key;
+        return less;
+#endif
+    }
+
+    // number of keys in the inner node smaller than or equal to key, i.e. 
+    // the child to descend into
+    static int countLessEqual(const Inner& node, int key) {
+        if (key == std::numeric_limits<int>::max()) return node.count;
+        return countLess(node.keys, key + 1);
+    }
+
+    int findLeaf(int key) const {
+        int id = root;
+        for (int level = levels; level > 0; level--) id = inners[id].children[countLessEqual(inners[id], key)];
+        return id;
+    }
+
+    // The tree is at most log16(n) levels deep, so recursion is fine here.
+    bool insert(int id, int level, int key, Split& split) {
+        if (level == 0) {
+            int* keys = leafKeys[id].keys;
+            int& n = leafCount[id];
+            int pos = countLess(keys, key);
+            if (pos < n && keys[pos] == key) return false;
+
+            std::copy_backward(keys + pos, keys + n, keys + n + 1);
+            keys[pos] = key;
+            if (++n == order) splitLeaf(id, split);
+            return true;
+        }
+
+        int c = countLessEqual(inners[id], key);
+        Split below;
+        bool added = insert(inners[id].children[c], level - 1, key, below);
+        if (below.right < 0) return added;
+
+        // inners may have been reallocated by the child's split
+        Inner& inner = inners[id];
+        std::copy_backward(inner.keys + c, inner.keys + inner.count, inner.keys + inner.count + 1);
+        std::copy_backward(inner.children + c + 1, inner.children + inner.count + 1, 
+                           inner.children + inner.count + 2);
+        inner.keys[c] = below.key;
+        inner.children[c + 1] = below.right;
+        if (++inner.count == order) splitInner(id, split);
+        return added;
+    }
+
+    void splitLeaf(int id, Split& split) {
+        int right = newLeaf();
+        int* left = leafKeys[id].keys;
+        int* r = leafKeys[right].keys;
+        int half = order / 2;
+
+        std::copy(left + half, left + order, r);
+        std::fill(left + half, left + order, std::numeric_limits<int>::max());
+        leafCount[right] = order - half;
+        leafCount[id] = half;
+        leafNext[right] = leafNext[id];
+        leafNext[id] = right;
+
+        split = { r[0], right };
+    }
+
+    void splitInner(int id, Split& split) {
+        int right = newInner();
+        Inner& left = inners[id];
+        Inner& r = inners[right];
+        int mid = order / 2;
+
+        // keys[mid] moves up; the right node takes everything after it
+        std::copy(left.keys + mid + 1, left.keys + order, r.keys);
+        std::copy(left.children + mid + 1, left.children + order + 1, r.children);
+        r.count = order - mid - 1;
+        split = { left.keys[mid], right };
+        std::fill(left.keys + mid, left.keys + order, std::numeric_limits<int>::max());
+        left.count = mid;
+    }
+};
+
+// Same output as inorderRecursive/inorderIterative on a binary search tree 
+// holding the same keys.
+void inorderIterative(const BPlusTree& tree) {
+    tree.forEachInorder([](int key) { std::cout << key << " "; });
+}
+
+void benchmarkBPlusTree(int n) {
+    std::mt19937 rng(5);
+    std::vector<int> values(n);
+    for (int& v : values) v = (int)(rng() % (4u * n));
+
+    BPlusTree wide;
+    BalancedTree binary;
+    double buildWide = timeMs([&] { for (int v : values) wide.insert(v); });
+    double buildBinary = timeMs([&] { for (int v : values) binary.insert(v); });
+
+    size_t foundWide = 0, foundBinary = 0;
+    double findWide = timeMs([&] { for (int v : values) foundWide += wide.contains(v + 1); });
+    double findBinary = timeMs([&] { for (int v : values) foundBinary += binary.contains(v + 1); });
+
+    // range scans of ~1000 keys each
+    long long sumWide = 0, sumBinary = 0;
+    int scans = std::min(n, 1000);
+    double scanWide = timeMs([&] {
+        for (int i = 0; i < scans; i++)
+        {
+            wide.forEachInRange(values[i], values[i] + 4000, [&](int k) { sumWide += k; });
+        }
+    });
+    double scanBinary = timeMs([&] {
+        std::vector<const Node*> stack;
+        for (int i = 0; i < scans; i++)
+        {
+            int lo = values[i], hi = values[i] + 4000;
+            stack.clear();
+            for (const Node* curr = binary.root().get(); curr;)
+            {
+                if (curr->data >= lo) {
+                    stack.push_back(curr);
+                    curr = curr->left.get();
+                } else {
+                    curr = curr->right.get();
+                }
+            }
+            while (!stack.empty() && stack.back()->data < hi)
+            {
+                const Node* curr = stack.back();
+                stack.pop_back();
+                sumBinary += curr->data;
+                for (const Node* next = curr->right.get(); next; next = next->left.get()) stack.push_back(next);
+            }
+        }
+    });
+
+    std::cout << "B+-tree n=" << n << " (" << wide.size() << " keys)\n"
+              << "  build:  b+tree " << buildWide << " ms, binary " << buildBinary << " ms\n"
+              << "  lookup: b+tree " << findWide << " ms, binary " << findBinary << " ms"
+              << (foundWide == foundBinary ? "" : " MISMATCH") << "\n"
+              << "  scan:   b+tree " << scanWide << " ms, binary " << scanBinary << " ms"
+              << (sumWide == sumBinary ? "" : " MISMATCH") << "\n";
+}
+
+// Node storage arena. Nodes created through NodeAllocator are carved out of 
+// large chunks one after the other, so a tree built in one go sits in 
+// contiguous memory (control block and Node side by side, in creation 
+// order). Every node's control block holds a copy of the allocator and with
+// it a reference to the arena, which is freed only after its last node.
+class NodeArena {
+public:
+    explicit NodeArena(size_t chunkBytes = 1 << 20) : chunkBytes(chunkBytes) {}
+
+    void* allocate(size_t bytes, size_t align) {
+        size_t offset = (used + align - 1) & ~(align - 1);
+        if (chunks.empty() || offset + bytes > capacity) {
+            capacity = std::max(chunkBytes, bytes);
+            // new[] memory is aligned for any fundamental type
+            chunks.emplace_back(new char[capacity]);
+            offset = 0;
+        }
+        used = offset + bytes;
+        return chunks.back().get() + offset;
+    }
+
+private:
+    size_t chunkBytes;
+    size_t capacity = 0;
+    size_t used = 0;
+    std::vector<std::unique_ptr<char[]>> chunks;
+};
+
+template <typename T>
+struct NodeAllocator {
+    using value_type = T;
+
+    std::shared_ptr<NodeArena> arena;
+
+    explicit NodeAllocator(std::shared_ptr<NodeArena> arena) : arena(std::move(arena)) {}
+    template <typename U>
+    NodeAllocator(const NodeAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    // memory goes back all at once when the arena is destroyed
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const NodeAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const NodeAllocator<U>& other) const { return arena != other.arena; }
+};
+
+// Bulk-loads a perfectly balanced binary search tree from sorted values in 
+// O(n): the middle value becomes the root and each half is built the same 
+// way, with no comparisons and no rebalancing. Nodes are allocated in 
+// preorder from one arena, so a depth-first walk reads memory front to back.
+// The recursion is only log2(n) deep.
+NodePtr buildFromSorted(const int* values, size_t n, const NodeAllocator<Node>& alloc) {
+    if (n == 0) return nullptr;
+    size_t mid = n / 2;
+    NodePtr node = std::allocate_shared<Node>(alloc, values[mid]);
+    node->left = buildFromSorted(values, mid, alloc);
+    node->right = buildFromSorted(values + mid + 1, n - mid - 1, alloc);
+    return node;
+}
+
+// roughly what one node costs with its control block
+const size_t nodeBytesEstimate = sizeof(Node) + 32;
+
+NodePtr buildFromSorted(const std::vector<int>& sorted) {
+    auto arena = std::make_shared<NodeArena>(std::max<size_t>(sorted.size(), 1) * nodeBytesEstimate);
+    return buildFromSorted(sorted.data(), sorted.size(), NodeAllocator<Node>(arena));
+}
+
+// Reads whitespace-separated sorted integers until the end of the stream. 
+// The count is not known up front, so the values are buffered first (4 bytes
+// each) and the tree is then built in one pass.
+NodePtr buildFromSorted(std::istream& in) {
+    std::vector<int> sorted;
+    int value;
+    while (in >> value) sorted.push_back(value);
+    return buildFromSorted(sorted);
+}
+
+// Parallel variant: the top `levels` levels are split recursively and the 
+// two halves of each split are built concurrently, each subtree below the 
+// split into its own arena so the threads never share an allocator.
+NodePtr buildFromSortedTop(const int* values, size_t n, int levels) {
+    if (n == 0) return nullptr;
+    if (levels == 0) {
+        auto arena = std::make_shared<NodeArena>(n * nodeBytesEstimate);
+        return buildFromSorted(values, n, NodeAllocator<Node>(arena));
+    }
+
+    size_t mid = n / 2;
+    auto left = std::async(std::launch::async, buildFromSortedTop, values, mid, levels - 1);
+    NodePtr right = buildFromSortedTop(values + mid + 1, n - mid - 1, levels - 1);
+
+    NodePtr node = std::make_shared<Node>(values[mid]);
+    node->left = left.get();
+    node->right = std::move(right);
+    return node;
+}
+
+NodePtr buildFromSortedParallel(const std::vector<int>& sorted, int levels = 3) {
+    return buildFromSortedTop(sorted.data(), sorted.size(), levels);
+}
+
+void benchmarkBulkLoad(int n) {
+    std::vector<int> sorted(n);
+    for (int i = 0; i < n; i++) sorted[i] = 2 * i;
+
+    NodePtr bulk, parallel;
+    BalancedTree inserted;
+    double tBulk = timeMs([&] { bulk = buildFromSorted(sorted); });
+    double tParallel = timeMs([&] { parallel = buildFromSortedParallel(sorted); });
+    double tInsert = timeMs([&] { for (int v : sorted) inserted.insert(v); });
+
+    std::cout << "Bulk load n=" << n << "\n"
+              << "  sorted build:   " << tBulk << " ms (height " << height(bulk) + 1 << ")\n"
+              << "  parallel build: " << tParallel << " ms\n"
+              << "  insertion:      " << tInsert << " ms (height " << height(inserted.root()) + 1 << ")\n"
+              << "  identical:      " << isIdentical(bulk, parallel) << "\n";
+}
+
+// Building a tree from traversal sequences. All three builders read their 
+// input incrementally from streams of whitespace-separated integers and 
+// assume the values are distinct (otherwise the tree is ambiguous).
+//
+// (a) Preorder + inorder. Preorder lists each node before its subtrees, 
+// inorder finishes a node's left subtree before the node itself. Keeping the
+// path of nodes whose left subtree is still open on a stack, the next 
+// preorder value is the left child of the stack top, unless the inorder 
+// sequence says the top is finished: then pop finished nodes and the value 
+// is the right child of the last one popped. Both streams are read strictly 
+// front to back, so only the O(height) stack is kept and no lookup is needed.
+NodePtr buildFromPreorderInorder(std::istream& preorder, std::istream& inorder) {
+    int value;
+    if (!(preorder >> value)) return nullptr;
+
+    NodePtr root = std::make_shared<Node>(value);
+    std::vector<Node*> stack = { root.get() };
+
+    int nextInorder;
+    bool haveInorder = (bool)(inorder >> nextInorder);
+
+    while (preorder >> value)
+    {
+        NodePtr node = std::make_shared<Node>(value);
+        Node* parent = nullptr;
+        while (!stack.empty() && haveInorder && stack.back()->data == nextInorder)
+        {
+            parent = stack.back();
+            stack.pop_back();
+            haveInorder = (bool)(inorder >> nextInorder);
+        }
+
+        Node* raw = node.get();
+        if (parent) {
+            parent->right = std::move(node);
+        } else {
+            stack.back()->left = std::move(node);
+        }
+        stack.push_back(raw);
+    }
+    return root;
+}
+
+// (b) Postorder + inorder. Postorder emits a node right after its right 
+// subtree, which itself follows the left subtree, so completed subtrees are 
+// kept on a stack together with the inorder interval they cover. When a 
+// value with inorder position i arrives, the subtree on top starting at 
+// i + 1 is its right child and the one below it ending at i - 1 its left 
+// child. Positions come from a value -> index map built from the inorder 
+// stream, so each step is O(1); the postorder stream is consumed as it goes.
+NodePtr buildFromPostorderInorder(std::istream& postorder, std::istream& inorder) {
+    std::unordered_map<int, int> position;
+    int value;
+    for (int i = 0; inorder >> value; i++) position[value] = i;
+
+    struct Subtree { NodePtr node; int lo; int hi; };
+    std::vector<Subtree> stack;
 
+    while (postorder >> value)
+    {
+        auto it = position.find(value);
+        if (it == position.end()) return nullptr;
+        int i = it->second;
+
+        Subtree built = { std::make_shared<Node>(value), i, i };
+        if (!stack.empty() && stack.back().lo == i + 1) {
+            built.hi = stack.back().hi;
+            built.node->right = std::move(stack.back().node);
+            stack.pop_back();
+        }
+        if (!stack.empty() && stack.back().hi == i - 1) {
+            built.lo = stack.back().lo;
+            built.node->left = std::move(stack.back().node);
+            stack.pop_back();
+        }
+        stack.push_back(std::move(built));
+    }
+    return stack.size() == 1 ? std::move(stack.back().node) : nullptr;
+}
+
+// (c) Level order with null markers, e.g. "1 2 3 # # 4 5" where every 
+// existing node is followed, in queue order, by the tokens for its two 
+// children. Only the nodes still waiting for their children are kept, which
+// is at most about two levels.
+NodePtr buildFromLevelorder(std::istream& in, const std::string& nullMarker = "#") {
+    std::string token;
+    if (!(in >> token) || token == nullMarker) return nullptr;
+
+    NodePtr root = std::make_shared<Node>(std::stoi(token));
+    RingBuffer<Node*> waiting;
+    waiting.push(root.get());
+
+    auto readChild = [&](NodePtr& link) {
+        if (!(in >> token)) return false;
+        if (token != nullMarker) {
+            link = std::make_shared<Node>(std::stoi(token));
+            waiting.push(link.get());
+        }
+        return true;
+    };
+
+    while (!waiting.empty())
+    {
+        Node* parent = waiting.pop();
+        if (!readChild(parent->left) || !readChild(parent->right)) break;
+    }
+    return root;
+}
+
+// Persistent (immutable) versions of a binary search tree. An update never
+// modifies a node: it copies the nodes on the path from the root down to 
+// the change and returns a new root, while every subtree off that path is 
+// shared with the previous version through the existing shared_ptr links. 
+// Old roots stay valid and keep seeing their own version, and each update 
+// costs O(height) new nodes - O(log n) on a balanced tree.
+//
+// This only holds as long as nobody mutates nodes in place: sumPostorder, 
+// mirror, truncate and friends would change every version sharing them.
+NodePtr copyNode(const Node* node) {
+    NodePtr copy = std::make_shared<Node>(node->data);
+    copy->left = node->left;
+    copy->right = node->right;
+    return copy;
+}
+
+// Rebuilds the path bottom-up: path[i + 1] is a child of path[i], and the 
+// copy of path[i] gets `replacement` in place of that child.
+NodePtr copyPath(const std::vector<const Node*>& path, NodePtr replacement, int value) {
+    for (size_t i = path.size(); i-- > 0;)
+    {
+        NodePtr copy = copyNode(path[i]);
+        (value < path[i]->data ? copy->left : copy->right) = std::move(replacement);
+        replacement = std::move(copy);
+    }
+    return replacement;
+}
+
+NodePtr persistentInsert(const NodePtr& root, int value) {
+    std::vector<const Node*> path;
+    for (const Node* curr = root.get(); curr;)
+    {
+        if (curr->data == value) return root;
+        path.push_back(curr);
+        curr = value < curr->data ? curr->left.get() : curr->right.get();
+    }
+    return copyPath(path, std::make_shared<Node>(value), value);
+}
+
+NodePtr persistentErase(const NodePtr& root, int value) {
+    std::vector<const Node*> path;
+    const Node* curr = root.get();
+    while (curr && curr->data != value)
+    {
+        path.push_back(curr);
+        curr = value < curr->data ? curr->left.get() : curr->right.get();
+    }
+    if (!curr) return root;
+
+    NodePtr replacement;
+    if (!curr->left || !curr->right) {
+        replacement = curr->left ? curr->left : curr->right;
+    } else {
+        // the inorder successor takes the erased node's place; the nodes 
+        // between it and curr->right are copied without it
+        std::vector<const Node*> down;
+        const Node* successor = curr->right.get();
+        while (successor->left)
+        {
+            down.push_back(successor);
+            successor = successor->left.get();
+        }
+        NodePtr right = successor->right;
+        for (size_t i = down.size(); i-- > 0;)
+        {
+            NodePtr copy = copyNode(down[i]);
+            copy->left = std::move(right);
+            right = std::move(copy);
+        }
+        replacement = std::make_shared<Node>(successor->data);
+        replacement->left = curr->left;
+        replacement->right = std::move(right);
+    }
+    return copyPath(path, std::move(replacement), value);
+}
+
+// Applies `updates` random inserts to a balanced tree of n nodes, keeping 
+// every version alive, and reports how many distinct nodes all versions 
+// hold together.
+void benchmarkPersistent(int n, int updates) {
+    std::vector<int> sorted(n);
+    for (int i = 0; i < n; i++) sorted[i] = 2 * i;
+
+    std::vector<NodePtr> versions = { buildFromSorted(sorted) };
+    std::mt19937 rng(13);
+    double ms = timeMs([&] {
+        for (int i = 0; i < updates; i++)
+        {
+            int value = 2 * (int)(rng() % n) + 1;
+            versions.push_back(persistentInsert(versions.back(), value));
+        }
+    });
+
+    std::unordered_map<const Node*, bool> seen;
+    std::vector<const Node*> stack;
+    for (auto& version : versions)
+    {
+        if (version) stack.push_back(version.get());
+        while (!stack.empty())
+        {
+            const Node* curr = stack.back();
+            stack.pop_back();
+            if (!seen.emplace(curr, true).second) continue;
+            if (curr->left) stack.push_back(curr->left.get());
+            if (curr->right) stack.push_back(curr->right.get());
+        }
+    }
+
+    std::cout << "Persistent n=" << n << " updates=" << updates << ": " << ms << " ms, "
+              << (double)(seen.size() - n) / updates << " new nodes per update (height " 
+              << height(versions.back()) + 1 << ")\n";
+}
+
+// Top and bottom views over raw node pointers, for readers that must not 
+// touch reference counts (printTop/printBottom copy a NodePtr per call, and
+// every copy is an atomic increment on a shared counter). A level-order walk
+// sees each column's topmost node first and its bottommost node last; left 
+// and right columns go into two flat arrays instead of a std::map.
+template <bool Top>
+std::vector<int> columnView(const Node* root) {
+    std::vector<int> left, right;     // columns -1, -2, ... and 0, 1, ...
+    if (!root) return {};
+
+    std::vector<std::pair<const Node*, int>> level = { { root, 0 } }, next;
+    while (!level.empty())
+    {
+        next.clear();
+        for (auto [curr, dist] : level)
+        {
+            std::vector<int>& side = dist < 0 ? left : right;
+            size_t slot = dist < 0 ? -dist - 1 : dist;
+            if (slot >= side.size()) {
+                side.push_back(curr->data);
+            } else if (!Top) {
+                side[slot] = curr->data;
+            }
+            if (curr->left) next.push_back({ curr->left.get(), dist - 1 });
+            if (curr->right) next.push_back({ curr->right.get(), dist + 1 });
+        }
+        level.swap(next);
+    }
+
+    std::vector<int> view(left.rbegin(), left.rend());
+    view.insert(view.end(), right.begin(), right.end());
+    return view;
+}
+
+std::vector<int> topView(const Node* root) { return columnView<true>(root); }
+std::vector<int> bottomView(const Node* root) { return columnView<false>(root); }
+
+// A search tree for many concurrent readers and a single writer, RCU style.
+// The writer never modifies a published node: it builds the next version 
+// with persistentInsert/persistentErase and publishes its root with one 
+// atomic store. Readers load that root as a plain pointer and walk raw 
+// pointers, so reading never writes shared memory except the reader's own
+// epoch slot.
+//
+// Reclamation is epoch based. A reader announces the global epoch in its 
+// slot before loading the root and clears the slot when done. Guards on the 
+// same slot may nest: an inner guard leaves the outer epoch in place, which
+// protects its own, newer snapshot as well, and only the outermost guard 
+// clears the slot. Each version 
+// the writer replaces is retired with the epoch it was current in, and 
+// released once every active reader announced a later epoch - no reader can
+// still be looking at it. Releasing the old root only frees the nodes that 
+// the new version does not share.
+//
+// Slots come from a free list, so threads can come and go as long as at most
+// maxReaders hold one at a time. A Reader handle gives its slot back when it
+// is destroyed.
+class SnapshotTree {
+public:
+    static const int maxReaders = 64;
+
+    explicit SnapshotTree(NodePtr root = nullptr) : current(std::move(root))
+    {
+        published.store(current.get());
+        for (auto& slot : slots) slot.store(0);
+        for (int slot = maxReaders - 1; slot >= 0; slot--) freeSlots.push_back(slot);
+    }
+
+    // Each reader thread claims a slot once and passes it to read(). Returns
+    // -1 while all maxReaders slots are taken.
+    int registerReader() {
+        std::lock_guard<std::mutex> lock(registry);
+        if (freeSlots.empty()) return -1;
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        registered[slot].store(true);
+        return slot;
+    }
+
+    // The slot must not be inside a read() any more.
+    void unregisterReader(int reader) {
+        std::lock_guard<std::mutex> lock(registry);
+        if (reader < 0 || reader >= maxReaders || !registered[reader].load()) {
+            throw std::out_of_range("SnapshotTree: reader slot is not registered");
+        }
+        registered[reader].store(false);
+        slots[reader].store(0);
+        freeSlots.push_back(reader);
+    }
+
+    class ReadGuard {
+    public:
+        ReadGuard(std::atomic<uint64_t>& slot, const std::atomic<uint64_t>& epoch, 
+                  const std::atomic<const Node*>& published) : slot(slot)
+        {
+            // only this reader's thread writes the slot, so a nonzero value
+            // is an enclosing guard's epoch
+            outermost = slot.load(std::memory_order_relaxed) == 0;
+            if (outermost) slot.store(epoch.load());
+            snapshot = published.load();
+        }
+        ~ReadGuard() { if (outermost) slot.store(0, std::memory_order_release); }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        const Node* root() const { return snapshot; }
+
+    private:
+        std::atomic<uint64_t>& slot;
+        const Node* snapshot;
+        bool outermost;
+    };
+
+    // The snapshot stays valid, and unchanged, while the guard lives, also 
+    // when guards on the slot nest. Throws std::out_of_range for a slot that
+    // is not registered.
+    ReadGuard read(int reader) {
+        if (reader < 0 || reader >= maxReaders || !registered[reader].load()) {
+            throw std::out_of_range("SnapshotTree: reader slot is not registered");
+        }
+        return ReadGuard(slots[reader], epoch, published);
+    }
+
+    // Owns a registered slot and unregisters it when destroyed.
+    class Reader {
+    public:
+        Reader(SnapshotTree& tree, int slot) : tree(&tree), slot(slot) {}
+        Reader(Reader&& other) : tree(other.tree), slot(other.slot) { other.tree = nullptr; }
+        Reader& operator=(Reader&&) = delete;
+        Reader(const Reader&) = delete;
+        ~Reader() { if (tree) tree->unregisterReader(slot); }
+
+        ReadGuard read() { return tree->read(slot); }
+
+    private:
+        SnapshotTree* tree;
+        int slot;
+    };
+
+    Reader reader() {
+        int slot = registerReader();
+        if (slot < 0) throw std::out_of_range("SnapshotTree: all reader slots are taken");
+        return Reader(*this, slot);
+    }
+
+    // Writer side; only one thread may call these.
+    template <typename Update>
+    void update(Update makeNext) {
+        NodePtr next = makeNext(current);
+        if (next == current) return;
+
+        published.store(next.get());
+        uint64_t e = epoch.fetch_add(1);
+        retired.push_back({ e, std::move(current) });
+        current = std::move(next);
+        reclaim();
+    }
+
+    void insert(int value) { update([value](const NodePtr& r) { return persistentInsert(r, value); }); }
+    void erase(int value) { update([value](const NodePtr& r) { return persistentErase(r, value); }); }
+
+    size_t pendingVersions() const { return retired.size(); }
+
+private:
+    NodePtr current;                        // owned by the writer
+    std::atomic<const Node*> published;
+    std::atomic<uint64_t> epoch{1};
+    std::atomic<uint64_t> slots[maxReaders];
+    std::mutex registry;                    // guards freeSlots and registered
+    std::vector<int> freeSlots;
+    std::atomic<bool> registered[maxReaders] = {};   // written under registry
+    std::vector<std::pair<uint64_t, NodePtr>> retired;
+
+    void reclaim() {
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (auto& slot : slots)
+        {
+            uint64_t e = slot.load();
+            if (e) oldest = std::min(oldest, e);
+        }
+        size_t kept = 0;
+        for (auto& entry : retired)
+        {
+            if (entry.first >= oldest) retired[kept++] = std::move(entry);
+        }
+        retired.resize(kept);
+    }
+};
+
+// Runs `threads` readers computing top views over a tree of n nodes while 
+// one writer inserts, and reports the readers' combined throughput.
+void benchmarkSnapshotReaders(int n, int threads, int queriesPerReader) {
+    std::vector<int> sorted(n);
+    for (int i = 0; i < n; i++) sorted[i] = 2 * i;
+    SnapshotTree tree(buildFromSorted(sorted));
+
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        std::mt19937 rng(17);
+        while (!done.load()) tree.insert(2 * (int)(rng() % n) + 1);
+    });
+
+    std::vector<std::thread> readers;
+    std::atomic<long long> checksum{0};
+    double ms = timeMs([&] {
+        for (int t = 0; t < threads; t++)
+        {
+            readers.emplace_back([&] {
+                auto reader = tree.reader();
+                long long sum = 0;
+                for (int q = 0; q < queriesPerReader; q++)
+                {
+                    auto guard = reader.read();
+                    for (int value : topView(guard.root())) sum += value;
+                }
+                checksum += sum;
+            });
+        }
+        for (auto& r : readers) r.join();
+    });
+    done.store(true);
+    writer.join();
+
+    std::cout << "Snapshot readers n=" << n << " threads=" << threads << ": " 
+              << threads * queriesPerReader / ms * 1000 << " queries/s\n";
+}
+
+// Lock-free concurrent binary search tree for insert-heavy ingest. It has 
+// the same shape as Node, but the child links are atomic raw pointers: 
+// shared_ptr links can only be updated atomically through a lock (the 
+// std::atomic_* overloads for shared_ptr use a hidden mutex pool), and every
+// reader would churn the reference counts.
+//
+// An insert walks down to an empty link and claims it with a single 
+// compare-and-swap. If another thread won the race the CAS returns the node 
+// it installed and the walk simply continues from there. Searches only load
+// links and never wait. Nodes are never removed while the tree is shared, so
+// no reader can see a freed node and no hazard pointers or epochs are needed;
+// all nodes are released together when the tree is destroyed.
+struct AtomicNode {
+    int data;
+    std::atomic<AtomicNode*> right{nullptr};
+    std::atomic<AtomicNode*> left{nullptr};
+    AtomicNode(int i_data) : data(i_data) {}
+};
+
+class ConcurrentTree {
+public:
+    ConcurrentTree() = default;
+    ConcurrentTree(const ConcurrentTree&) = delete;
+    ConcurrentTree& operator=(const ConcurrentTree&) = delete;
+
+    ~ConcurrentTree() {
+        std::vector<AtomicNode*> stack;
+        if (AtomicNode* r = root.load()) stack.push_back(r);
+        while (!stack.empty())
+        {
+            AtomicNode* curr = stack.back();
+            stack.pop_back();
+            if (AtomicNode* l = curr->left.load()) stack.push_back(l);
+            if (AtomicNode* r = curr->right.load()) stack.push_back(r);
+            delete curr;
+        }
+    }
+
+    // Returns false if the value was already present. Safe to call from any
+    // number of threads concurrently with insert and contains.
+    bool insert(int value) {
+        AtomicNode* node = nullptr;
+        std::atomic<AtomicNode*>* link = &root;
+        while (true)
+        {
+            AtomicNode* curr = link->load(std::memory_order_acquire);
+            if (!curr) {
+                if (!node) node = new AtomicNode(value);
+                if (link->compare_exchange_weak(curr, node, std::memory_order_release, 
+                                                std::memory_order_acquire)) {
+                    count.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if (!curr) continue;    // spurious failure, retry the same link
+            }
+            if (curr->data == value) {
+                delete node;
+                return false;
+            }
+            link = value < curr->data ? &curr->left : &curr->right;
+        }
+    }
+
+    bool contains(int value) const {
+        const AtomicNode* curr = root.load(std::memory_order_acquire);
+        while (curr && curr->data != value)
+        {
+            curr = (value < curr->data ? curr->left : curr->right).load(std::memory_order_acquire);
+        }
+        return curr != nullptr;
+    }
+
+    size_t size() const { return count.load(); }
+
+    // Copies the current contents into an ordinary Node tree (same shape), 
+    // so the traversal and view functions can be used on it.
+    NodePtr snapshot() const {
+        const AtomicNode* r = root.load(std::memory_order_acquire);
+        if (!r) return nullptr;
+
+        NodePtr copy = std::make_shared<Node>(r->data);
+        std::vector<std::pair<const AtomicNode*, Node*>> stack = { { r, copy.get() } };
+        while (!stack.empty())
+        {
+            auto [from, to] = stack.back();
+            stack.pop_back();
+            if (const AtomicNode* l = from->left.load(std::memory_order_acquire)) {
+                to->left = std::make_shared<Node>(l->data);
+                stack.push_back({ l, to->left.get() });
+            }
+            if (const AtomicNode* rr = from->right.load(std::memory_order_acquire)) {
+                to->right = std::make_shared<Node>(rr->data);
+                stack.push_back({ rr, to->right.get() });
+            }
+        }
+        return copy;
+    }
+
+private:
+    std::atomic<AtomicNode*> root{nullptr};
+    std::atomic<size_t> count{0};
+};
+
+// Inserts n random values split across `threads` threads, then looks each 
+// one up again, comparing the lock-free tree with a BalancedTree behind a 
+// mutex.
+void benchmarkConcurrentTree(int n, int threads) {
+    std::mt19937 rng(19);
+    std::vector<int> values(n);
+    for (int& v : values) v = (int)rng();
 
+    auto runThreads = [&](auto work) {
+        std::vector<std::thread> pool;
+        size_t chunk = (n + threads - 1) / threads;
+        for (int t = 0; t < threads; t++)
+        {
+            size_t begin = t * chunk, end = std::min((size_t)n, begin + chunk);
+            pool.emplace_back([&, begin, end] { work(begin, end); });
+        }
+        for (auto& th : pool) th.join();
+    };
+
+    ConcurrentTree lockFree;
+    BalancedTree locked;
+    std::mutex mutex;
+    std::atomic<size_t> foundLockFree{0}, foundLocked{0};
+
+    double insertLockFree = timeMs([&] {
+        runThreads([&](size_t b, size_t e) { for (size_t i = b; i < e; i++) lockFree.insert(values[i]); });
+    });
+    double insertLocked = timeMs([&] {
+        runThreads([&](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                locked.insert(values[i]);
+            }
+        });
+    });
+    double findLockFree = timeMs([&] {
+        runThreads([&](size_t b, size_t e) {
+            size_t found = 0;
+            for (size_t i = b; i < e; i++) found += lockFree.contains(values[i]);
+            foundLockFree += found;
+        });
+    });
+    double findLocked = timeMs([&] {
+        runThreads([&](size_t b, size_t e) {
+            size_t found = 0;
+            for (size_t i = b; i < e; i++)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                found += locked.contains(values[i]);
+            }
+            foundLocked += found;
+        });
+    });
+
+    std::cout << "Concurrent tree n=" << n << " threads=" << threads << "\n"
+              << "  insert: lock-free " << n / insertLockFree * 1000 << " ops/s, mutex " 
+              << n / insertLocked * 1000 << " ops/s\n"
+              << "  search: lock-free " << n / findLockFree * 1000 << " ops/s, mutex " 
+              << n / findLocked * 1000 << " ops/s"
+              << (foundLockFree == foundLocked && lockFree.size() == locked.size() ? "" : " MISMATCH") << "\n";
+}
+
+// Parallel isIdentical for very large trees. The top `levels` levels are 
+// compared directly and the pairs of subtrees below them are compared 
+// concurrently, each with an explicit stack instead of recursion. All 
+// workers share one flag: the first mismatch sets it and the others notice
+// within a few hundred steps and give up.
+bool identicalIterative(const Node* x, const Node* y, std::atomic<bool>& mismatch) {
+    std::vector<std::pair<const Node*, const Node*>> stack = { { x, y } };
+    for (size_t steps = 0; !stack.empty(); steps++)
+    {
+        if ((steps & 255) == 0 && mismatch.load(std::memory_order_relaxed)) return false;
+
+        auto [a, b] = stack.back();
+        stack.pop_back();
+
+        if (!a && !b) continue;
+        if (!a || !b || a->data != b->data) {
+            mismatch.store(true);
+            return false;
+        }
+        stack.push_back({ a->right.get(), b->right.get() });
+        stack.push_back({ a->left.get(), b->left.get() });
+    }
+    return true;
+}
+
+bool identicalTop(const Node* x, const Node* y, int levels, std::atomic<bool>& mismatch) {
+    if (!x && !y) return true;
+    if (!x || !y || x->data != y->data) {
+        mismatch.store(true);
+        return false;
+    }
+    if (levels == 0) return identicalIterative(x, y, mismatch);
+
+    auto left = std::async(std::launch::async, identicalTop, x->left.get(), y->left.get(), 
+                           levels - 1, std::ref(mismatch));
+    bool right = identicalTop(x->right.get(), y->right.get(), levels - 1, mismatch);
+    return left.get() && right && !mismatch.load();
+}
+
+bool isIdenticalParallel(NodePtr x, NodePtr y, int levels = 3) {
+    std::atomic<bool> mismatch{false};
+    return identicalTop(x.get(), y.get(), levels, mismatch);
+}
+
+// Contiguous (serialized) form of a tree: values in preorder plus one byte 
+// per node saying which children it has. Two trees are identical exactly 
+// when their flat forms are, so trees that are cached or shipped in this 
+// form compare with two memcmp calls instead of a pointer walk.
+struct FlatTree {
+    std::vector<int> values;
+    std::vector<uint8_t> shape;     // bit 0: has left child, bit 1: has right child
+};
+
+FlatTree flatten(NodePtr root) {
+    FlatTree flat;
+    if (!root) return flat;
+
+    std::vector<const Node*> stack = { root.get() };
+    while (!stack.empty())
+    {
+        const Node* curr = stack.back();
+        stack.pop_back();
+
+        flat.values.push_back(curr->data);
+        flat.shape.push_back((uint8_t)((curr->left ? 1 : 0) | (curr->right ? 2 : 0)));
+
+        if (curr->right) stack.push_back(curr->right.get());
+        if (curr->left) stack.push_back(curr->left.get());
+    }
+    return flat;
+}
+
+bool isIdentical(const FlatTree& x, const FlatTree& y) {
+    return x.values.size() == y.values.size()
+        && std::memcmp(x.shape.data(), y.shape.data(), x.shape.size()) == 0
+        && std::memcmp(x.values.data(), y.values.data(), x.values.size() * sizeof(int)) == 0;
+}
+
+void benchmarkIdentical(int n) {
+    NodePtr x = makeRandomTree(n), y = makeRandomTree(n);
+    // a late mismatch: change the leaf at the end of the rightmost path
+    NodePtr z = makeRandomTree(n);
+    for (Node* curr = z.get(); curr; curr = curr->right ? curr->right.get() : curr->left.get())
+    {
+        if (!curr->left && !curr->right) curr->data = -1;
+    }
+
+    int serial = 0;
+    bool parallel = false, mismatchSerial = false, mismatchParallel = false, flat = false;
+    double tSerial = timeMs([&] { serial = isIdentical(x, y); });
+    double tParallel = timeMs([&] { parallel = isIdenticalParallel(x, y); });
+    double tMismatchSerial = timeMs([&] { mismatchSerial = isIdentical(x, z); });
+    double tMismatchParallel = timeMs([&] { mismatchParallel = isIdenticalParallel(x, z); });
+
+    FlatTree fx = flatten(x), fy = flatten(y);
+    double tFlat = timeMs([&] { flat = isIdentical(fx, fy); });
+
+    std::cout << "Identical n=" << n << "\n"
+              << "  equal:    serial " << tSerial << " ms, parallel " << tParallel 
+              << " ms, flat " << tFlat << " ms (" << serial << parallel << flat << ")\n"
+              << "  mismatch: serial " << tMismatchSerial << " ms, parallel " << tMismatchParallel 
+              << " ms (" << mismatchSerial << mismatchParallel << ")\n";
+}
+
+// Subtree containment and isomorphism by canonical encoding (AHU style). 
+// Every subtree gets a small integer id such that two subtrees share an id 
+// exactly when they are identical: the id of a node is looked up from the
+// triple (data, id of left, id of right) in a dictionary, with 0 for the 
+// empty tree. For isomorphism under child swaps the two child ids are put in
+// sorted order first, so mirrored subtrees collapse onto the same id.
+//
+// Indexing A assigns ids to all its nodes in one postorder pass, O(|A|) 
+// expected. Asking whether B occurs in A then only encodes B against the 
+// same dictionary, O(|B|) per query: if some part of B has a triple A never
+// produced, B cannot occur, and otherwise its root id tells which node of A 
+// matches.
+class SubtreeIndex {
+public:
+    explicit SubtreeIndex(NodePtr a) {
+        encode<false>(a, [this](const Shape& s) { return idFor(exact, s); }, 
+                      [this](int id, const NodePtr& node) { exactRoots.emplace(id, node); });
+        encode<true>(a, [this](const Shape& s) { return idFor(unordered, s); }, 
+                     [this](int id, const NodePtr& node) { unorderedRoots.emplace(id, node); });
+    }
+
+    // A node of A whose subtree is identical to b, or nullptr.
+    NodePtr find(const NodePtr& b) const {
+        int id = encode<false>(b, [this](const Shape& s) { return lookup(exact, s); }, 
+                               [](int, const NodePtr&) {});
+        auto it = exactRoots.find(id);
+        return it == exactRoots.end() ? nullptr : it->second;
+    }
+
+    // A node of A whose subtree is isomorphic to b under child swaps, or nullptr.
+    NodePtr findIsomorphic(const NodePtr& b) const {
+        int id = encode<true>(b, [this](const Shape& s) { return lookup(unordered, s); }, 
+                              [](int, const NodePtr&) {});
+        auto it = unorderedRoots.find(id);
+        return it == unorderedRoots.end() ? nullptr : it->second;
+    }
+
+private:
+    struct Shape {
+        int data;
+        int left;
+        int right;
+        bool operator==(const Shape& o) const { return data == o.data && left == o.left && right == o.right; }
+    };
+
+    struct ShapeHash {
+        size_t operator()(const Shape& s) const {
+            uint64_t h = (uint64_t)(uint32_t)s.data * 0x9E3779B97F4A7C15ull;
+            h ^= (uint64_t)(uint32_t)s.left + 0x7F4A7C159E3779B9ull + (h << 6) + (h >> 2);
+            h ^= (uint64_t)(uint32_t)s.right + 0x94D049BB133111EBull + (h << 6) + (h >> 2);
+            return (size_t)h;
+        }
+    };
+
+    using Dictionary = std::unordered_map<Shape, int, ShapeHash>;
+
+    Dictionary exact, unordered;
+    std::unordered_map<int, NodePtr> exactRoots, unorderedRoots;   // id -> a node of A
+
+    static int idFor(Dictionary& dict, const Shape& s) {
+        return dict.emplace(s, (int)dict.size() + 1).first->second;
+    }
+
+    static int lookup(const Dictionary& dict, const Shape& s) {
+        auto it = dict.find(s);
+        return it == dict.end() ? -1 : it->second;
+    }
+
+    // Iterative postorder: returns the id of root, or -1 as soon as idOf 
+    // reports an unknown shape. onNode sees every (id, node) pair.
+    template <bool Unordered, typename IdOf, typename OnNode>
+    static int encode(const NodePtr& root, IdOf idOf, OnNode onNode) {
+        if (!root) return 0;
+
+        std::vector<std::pair<const NodePtr*, bool>> stack = { { &root, false } };
+        std::vector<int> ids;
+        while (!stack.empty())
+        {
+            auto [node, expanded] = stack.back();
+            stack.pop_back();
+
+            if (!*node) {
+                ids.push_back(0);
+            } else if (!expanded) {
+                stack.push_back({ node, true });
+                stack.push_back({ &(*node)->right, false });
+                stack.push_back({ &(*node)->left, false });
+            } else {
+                int right = ids.back();
+                ids.pop_back();
+                int left = ids.back();
+                ids.pop_back();
+                if (Unordered && left > right) std::swap(left, right);
+
+                int id = idOf(Shape{ (*node)->data, left, right });
+                if (id < 0) return -1;
+                onNode(id, *node);
+                ids.push_back(id);
+            }
+        }
+        return ids.back();
+    }
+};
+
+// Does b occur in a as a complete subtree? (The empty tree always does.)
+bool isSubtree(NodePtr a, NodePtr b) {
+    return !b || SubtreeIndex(a).find(b) != nullptr;
+}
+
+// Can x be turned into y by swapping the children of some nodes?
+bool isIsomorphic(NodePtr x, NodePtr y) {
+    if (!x || !y) return !x && !y;
+    NodePtr match = SubtreeIndex(x).findIsomorphic(y);
+    return match == x;
+}
+
+// Top and bottom views maintained incrementally. printTop and printBottom 
+// rebuild their whole map on every call; ViewIndex instead remembers, for 
+// every column (horizontal distance from the root), an ordered set of the 
+// nodes in it keyed by (level, left-to-right position). The top view is the
+// first entry of each column and the bottom view the last one, so a query 
+// costs O(width), and attaching or detaching a leaf through the index costs
+// O(log n).
+//
+// The left-to-right position of a node is its root path read as bits 
+// (left = 0, right = 1); nodes with equal column and level have paths of the
+// same length, so the bits compare like their horizontal order. Only the top
+// 64 levels fit in the key, which is plenty for balanced trees. Deeper nodes
+// whose first 64 turns agree are ordered by climbing to their common 
+// ancestor, the one under its left child first; such a comparison costs 
+// O(depth) instead of O(1). The sets' comparator 
+// reads the parent links from places, so the index cannot be copied.
+class ViewIndex {
+public:
+    explicit ViewIndex(NodePtr root) : root(std::move(root))
+    {
+        if (!this->root) return;
+        std::vector<std::pair<const Node*, Place>> stack = { { this->root.get(), Place{} } };
+        while (!stack.empty())
+        {
+            auto [curr, place] = stack.back();
+            stack.pop_back();
+            add(curr, place);
+            if (curr->right) stack.push_back({ curr->right.get(), childPlace(curr, place, false) });
+            if (curr->left) stack.push_back({ curr->left.get(), childPlace(curr, place, true) });
+        }
+    }
+    ViewIndex(const ViewIndex&) = delete;
+    ViewIndex& operator=(const ViewIndex&) = delete;
+
+    NodePtr tree() const { return root; }
+
+    // Attaches a new leaf under parent in the given empty slot and returns 
+    // it. Throws std::out_of_range, leaving the tree untouched, if parent is 
+    // not in the indexed tree.
+    NodePtr insert(const NodePtr& parent, bool left, int value) {
+        NodePtr& link = left ? parent->left : parent->right;
+        if (link) return nullptr;
+        Place place = childPlace(parent.get(), places.at(parent.get()), left);
+        link = std::make_shared<Node>(value);
+        add(link.get(), place);
+        return link;
+    }
+
+    // Detaches the child subtree of parent on the given side. A leaf costs 
+    // O(log n); a larger subtree O(k log n) for its k nodes.
+    void erase(const NodePtr& parent, bool left) {
+        NodePtr& link = left ? parent->left : parent->right;
+        if (!link) return;
+
+        // Children go before their parents: comparing a deep entry may climb
+        // through its ancestors' places.
+        std::vector<const Node*> order;
+        std::vector<const Node*> stack = { link.get() };
+        while (!stack.empty())
+        {
+            const Node* curr = stack.back();
+            stack.pop_back();
+            order.push_back(curr);
+            if (curr->left) stack.push_back(curr->left.get());
+            if (curr->right) stack.push_back(curr->right.get());
+        }
+        for (auto it = order.rbegin(); it != order.rend(); ++it) remove(*it);
+        std::vector<NodePtr> garbage;
+        garbage.push_back(std::move(link));
+        releaseSubtrees(garbage);
+    }
+
+    std::vector<int> topView() const { return view(true); }
+    std::vector<int> bottomView() const { return view(false); }
+
+private:
+    struct Place {
+        int column = 0;
+        int level = 0;
+        uint64_t path = 0;              // first 64 turns from the root
+        const Node* parent = nullptr;
+        bool left = false;              // which child of parent
+    };
+
+    struct Entry {
+        int level;
+        uint64_t path;
+        const Node* node;
+    };
+
+    typedef std::unordered_map<const Node*, Place> Places;
+
+    struct EntryLess {
+        const Places* places;
+
+        bool operator()(const Entry& a, const Entry& b) const {
+            if (a.level != b.level) return a.level < b.level;
+            if (a.path != b.path) return a.path < b.path;
+
+            // same level and first 64 turns: climb to the common ancestor
+            const Node* x = a.node;
+            const Node* y = b.node;
+            while (x != y)
+            {
+                const Place& px = places->at(x);
+                const Place& py = places->at(y);
+                if (px.parent == py.parent) return px.left && !py.left;
+                x = px.parent;
+                y = py.parent;
+            }
+            return false;
+        }
+    };
+
+    typedef std::set<Entry, EntryLess> Column;
+
+    NodePtr root;
+    Places places;
+    std::vector<Column> leftColumns;      // columns -1, -2, ...
+    std::vector<Column> rightColumns;     // columns 0, 1, ...
+
+    static Place childPlace(const Node* parentNode, const Place& parent, bool left) {
+        uint64_t path = parent.level < 64 ? (parent.path << 1) | (left ? 0 : 1) : parent.path;
+        return { parent.column + (left ? -1 : 1), parent.level + 1, path, parentNode, left };
+    }
+
+    Column& column(int c) {
+        std::vector<Column>& side = c < 0 ? leftColumns : rightColumns;
+        size_t slot = c < 0 ? -c - 1 : c;
+        if (slot >= side.size()) side.resize(slot + 1, Column(EntryLess{ &places }));
+        return side[slot];
+    }
+
+    void add(const Node* node, const Place& place) {
+        places[node] = place;
+        column(place.column).insert({ place.level, place.path, node });
+    }
+
+    void remove(const Node* node) {
+        auto it = places.find(node);
+        if (it == places.end()) return;
+        const Place& place = it->second;
+        column(place.column).erase({ place.level, place.path, node });
+        places.erase(it);
+    }
+
+    std::vector<int> view(bool top) const {
+        std::vector<int> out;
+        auto emit = [&](const Column& entries) {
+            if (!entries.empty()) out.push_back(top ? entries.begin()->node->data : entries.rbegin()->node->data);
+        };
+        for (auto it = leftColumns.rbegin(); it != leftColumns.rend(); ++it) emit(*it);
+        for (auto& entries : rightColumns) emit(entries);
+        return out;
+    }
+};
+
+void printTop(const ViewIndex& index) {
+    for (int value : index.topView()) std::cout << value << " ";
+}
+
+void printBottom(const ViewIndex& index) {
+    for (int value : index.bottomView()) std::cout << value << " ";
+}
 
-// - Print cousins of a given node in a binary tree
-// - Check if a binary tree is a sum tree or not
-// - Given a set of single-digit positive numbers, find all possible combinations
-// of words formed by replacing the continuous digits with corresponding 
-// character in the English alphabet, i.e., subset {1} can be replaced by A, 
-// {2} can be replaced by B, {1, 0} can be replaced by J, 
-// {2, 1} can be replaced by U, etc.
-// - Find the diameter of a binary tree
-// - Check if a binary tree is symmetric or not
-// - Convert a binary tree to its mirror
-// - Find the Lowest Common Ancestor (LCA) of two nodes in a binary tree
-// - Print all paths from the root to leaf nodes of a binary tree
-// - Find distance between given pairs of nodes in a binary tree
-// - Find the diagonal sum of a binary tree
-// - Truncate a binary tree to remove nodes that lie on a path having a sum less than `k`
-// - Convert a binary tree into a doubly-linked list in spiral order
-// - Invert Binary Tree
 // - Depth-First Search (DFS) vs Breadth-First Search (BFS)
-// - Find the minimum depth of a binary tree
-// - Compute the maximum number of nodes at any level in a binary tree
-// - Store words in a binary tree
 //
 int main()
 {
@@ -305,6 +4019,104 @@ int main()
     // printTop(root); // 4 2 1 3 6
     // std::cout << "\n" << sumPostorder(root) << " \n"; // 0 4 35 0 15 0 26 0
     // inorderRecursive(root);
+    // LcaIndex lca(root);
+    // std::cout << lca.lca(root->right->left->left, root->right->right)->data; // 3
+    // benchmarkLca(1000000, 1000000);
+    // std::cout << distance(lca, root->left->left, root->right->left->right); // 5
+    // Diameter d = diameter(root);
+    // std::cout << d.length << " " << d.from->data << " " << d.to->data; // 5 4 7
+    // benchmarkDiameter(1000000);
+    // std::cout << isSymmetric(root); // 0
+    // inorderIterative(TreeView{root}.mirror()); // 6 3 8 5 7 1 2 4
+    // mirror(root);
+    // inorderRecursive(root); // 6 3 8 5 7 1 2 4
+    // CousinIndex cousins(root);
+    // std::cout << cousins.areCousins(root->left->left, root->right->left); // 1
+    // cousins.printCousins(root->right->right); // 4
+
+    // SumTreeResult sum = isSumTree(root);
+    // std::cout << sum.isSumTree() << " " << sum.violation->data; // 0 2
+
+    // printPaths(root); // 1 2 4 / 1 3 5 7 / 1 3 5 8 / 1 3 6
+    // benchmarkPaths(10000000);
+
+    // for (long long sum : diagonalSum(root)) std::cout << sum << " "; // 10 15 11
+    // printDiagonal(root); // 1 3 6 / 2 5 8 / 4 7
+
+    // truncate(root, 12);
+    // inorderRecursive(root); // 1 7 5 8 3
+
+    // printSpiral(root); // 1 2 3 6 5 4 7 8
+    // NodePtr list = spiralToList(root); root = nullptr;
+    // printList(list); // 1 2 3 6 5 4 7 8
+    // releaseList(list);
+    // benchmarkSpiral(10000000);
+
+    // std::cout << minDepth(root); // 3
+    // std::cout << maxWidth(root).width; // 3
+
+    // WordTree words;
+    // for (auto w : { "tree", "trie", "treap", "binary", "traversal" }) words.insert(w);
+    // words.printWithPrefix("tre"); // treap tree
+    // benchmarkWords(1000000);
+
+    // printDecodings({ 1, 2, 2, 1 }); // ABBA ABU AVA LBA LU
+    // std::cout << countDecodings({ 1, 2, 2, 1 }).count; // 5
+
+    // BalancedTree bst;
+    // for (int v : { 5, 3, 8, 1, 4, 7, 9, 2, 6 }) bst.insert(v);
+    // inorderRecursive(bst.root()); // 1 2 3 4 5 6 7 8 9
+    // printTop(bst.root());
+    // bst.enableOrderStatistics();
+    // std::cout << bst.select(3)->data << " " << bst.rank(7); // 4 6
+    // SubtreeAggregates<SumMonoid> sums;
+    // bst.addObserver(&sums);
+    // std::cout << sums.query(bst.root(), 3, 7); // 18
+    // benchmarkBalancedTree(1000000);
+
+    // BPlusTree wide;
+    // for (int v : { 5, 3, 8, 1, 4, 7, 9, 2, 6 }) wide.insert(v);
+    // inorderIterative(wide); // 1 2 3 4 5 6 7 8 9
+    // benchmarkBPlusTree(1000000);
+
+    // NodePtr loaded = buildFromSorted(std::vector<int>{ 1, 2, 3, 4, 5, 6, 7 });
+    // preorderRecursive(loaded); // 4 2 1 3 6 5 7
+    // benchmarkBulkLoad(10000000);
+
+    // std::istringstream pre("1 2 4 3 5 7 8 6"), in("4 2 1 7 5 8 3 6");
+    // std::cout << isIdentical(root, buildFromPreorderInorder(pre, in)); // 1
+    // std::istringstream level("1 2 3 4 # 5 6 # # 7 8");
+    // std::cout << isIdentical(root, buildFromLevelorder(level)); // 1
+
+    // NodePtr v1 = buildFromSorted(std::vector<int>{ 1, 2, 3, 4, 5, 6, 7 });
+    // NodePtr v2 = persistentErase(persistentInsert(v1, 8), 4);
+    // inorderRecursive(v1); // 1 2 3 4 5 6 7
+    // inorderRecursive(v2); // 1 2 3 5 6 7 8
+    // benchmarkPersistent(1000000, 100000);
+
+    // SnapshotTree shared(buildFromSorted(std::vector<int>{ 1, 2, 3, 4, 5, 6, 7 }));
+    // auto reader = shared.reader();
+    // shared.insert(8);
+    // for (int v : topView(reader.read().root())) std::cout << v << " "; // 1 2 4 6 7 8
+    // benchmarkSnapshotReaders(100000, 4, 1000);
+
+    // ConcurrentTree ingest;
+    // for (int v : { 5, 3, 8, 1, 4 }) ingest.insert(v);
+    // inorderRecursive(ingest.snapshot()); // 1 3 4 5 8
+    // benchmarkConcurrentTree(1000000, 8);
+
+    // std::cout << isIdenticalParallel(root, root); // 1
+    // std::cout << isIdentical(flatten(root), flatten(root)); // 1
+    // benchmarkIdentical(10000000);
+
+    // SubtreeIndex subtrees(root);
+    // std::cout << (subtrees.find(mirrorCopy(root->right)) != nullptr); // 0
+    // std::cout << (subtrees.findIsomorphic(mirrorCopy(root->right)) == root->right); // 1
+
+    // ViewIndex views(root);
+    // views.insert(root->left->left, true, 9);
+    // printTop(views); // 9 4 2 1 3 6
+    // printBottom(views); // 9 4 7 5 8 6
 
     return 0;
 }